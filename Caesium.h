@@ -8,12 +8,14 @@
 
 #include "csm.h"
 #include "csm_renderbuffer.h"
+#include "csm_texture.h"
 #include "csm_window.h"
 #include "csm_mesh.h"
 #include "csm_matrix.h"
 #include "csm_buffer.h"
 #include "csm_renderclass.h"
 #include "csm_draw.h"
+#include "csm_commandlist.h"
 #include "csm_vertex.h"
 #include "csm_fragment.h"
 
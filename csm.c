@@ -13,8 +13,11 @@ CSMCALL BOOL CInitialize() {
 
 	// create unsafe heap
 	_csmint.heap = HeapCreate(HEAP_CREATE_ENABLE_EXECUTE, ZERO, ZERO);
+	_csmint.threadStateTls = TlsAlloc();
+	CInternalInitAllocator();
 
 	InitializeCriticalSection(&_csmint.lock);
+	InitializeCriticalSection(&_csmint.workerLock);
 
 	// setup perf freq
 	QueryPerformanceFrequency(&_csmint.perfCounterHzMs);
@@ -29,18 +32,30 @@ CSMCALL BOOL CInitialize() {
 }
 
 CSMCALL BOOL CTerminate() {
+	// finish async draws and stop worker threads first, both are counted as allocations
+	// note: done before taking the global lock to keep lock order consistent with draws
+	CInternalRenderThreadShutdown();
+	CInternalWorkerShutdown();
+
 	_CSyncEnter();
 
-	if (_csmint.allocateCount > 0) {
+	LONG allocateCount = CInternalAllocCount();
+	if (allocateCount > 0) {
 		CHAR errorBuff[0xFF];
 		sprintf_s(errorBuff, 0xFF,
 			"CTerminate failed because %d allocations were still unfreed",
-			_csmint.allocateCount
+			allocateCount
 		);
 		_CSyncLeaveErr(FALSE, errorBuff);
 	}
 	
-	HeapDestroy(&_csmint.heap);
+	DeleteCriticalSection(&_csmint.workerLock);
+
+	// allocator caches and slabs all live in the heap
+	DeleteCriticalSection(&_csmint.allocDepot->lock);
+	TlsFree(_csmint.allocTls);
+	TlsFree(_csmint.threadStateTls);
+	HeapDestroy(_csmint.heap);
 	DeleteCriticalSection(&_csmint.lock);
 
 	_csmint.init = FALSE;
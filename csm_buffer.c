@@ -36,10 +36,13 @@ CSMCALL CHandle CMakeVertexDataBuffer(PCHAR name, UINT32 elementCount,
 
 	// copy buffer
 	const SIZE_T dataSizeBytes = elementCount * elementComponents * sizeof(FLOAT);
-	vdBuffer->data = CInternalAlloc(dataSizeBytes);
+	vdBuffer->data = CInternalAllocUnzeroed(dataSizeBytes);
 	if (dataIn != NULL) {
 		COPY_BYTES(dataIn, vdBuffer->data, dataSizeBytes);
 	}
+	else {
+		ZERO_BYTES(vdBuffer->data, dataSizeBytes);
+	}
 
 	_CSyncLeave(vdBuffer);
 }
@@ -101,6 +104,8 @@ CSMCALL BOOL	CVertexDataBufferUnsafeGetElement(CHandle vdBuffer, UINT32 index,
 
 CSMCALL BOOL	CVertexDataBufferSetElement(CHandle vdBuffer, UINT32 index,
 	PFLOAT inBuffer) {
+	_CSyncEnter();
+
 	if (vdBuffer == NULL) {
 		_CSyncLeaveErr(FALSE, "CVertexDataBufferSetElement failed bevause vdBuffer was invalid");
 	}
@@ -148,6 +153,12 @@ CSMCALL UINT32	CVertexDataBufferGetComponentCount(CHandle vdBuffer) {
 	_CSyncLeave(vdb->elementComponents);
 }
 
+static PCStaticDataVersion _makeVersion(SIZE_T sizeBytes) {
+	PCStaticDataVersion version = CInternalAllocUnzeroed(sizeof(CStaticDataVersion) + sizeBytes);
+	version->refCount = 1;
+	return version;
+}
+
 CSMCALL CHandle CMakeStaticDataBuffer(PCHAR name, SIZE_T sizeBytes,
 	PVOID dataIn) {
 	_CSyncEnter();
@@ -162,7 +173,7 @@ CSMCALL CHandle CMakeStaticDataBuffer(PCHAR name, SIZE_T sizeBytes,
 	PCStaticDataBuffer sdBuffer = CInternalAlloc(sizeof(CStaticDataBuffer));
 
 	// init lock
-	InitializeCriticalSection(&sdBuffer->mapLock);
+	InitializeCriticalSection(&sdBuffer->versionLock);
 
 	// init name
 	const SIZE_T nameSize = strlen(name);
@@ -171,9 +182,11 @@ CSMCALL CHandle CMakeStaticDataBuffer(PCHAR name, SIZE_T sizeBytes,
 
 	// init data
 	sdBuffer->sizeBytes = sizeBytes;
-	sdBuffer->data = CInternalAlloc(sizeBytes);
+	sdBuffer->current	= _makeVersion(sizeBytes);
 	if (dataIn != NULL)
-		COPY_BYTES(dataIn, sdBuffer->data, sizeBytes);
+		COPY_BYTES(dataIn, sdBuffer->current->data, sizeBytes);
+	else
+		ZERO_BYTES(sdBuffer->current->data, sizeBytes);
 
 	_CSyncLeave(sdBuffer);
 }
@@ -190,14 +203,15 @@ CSMCALL BOOL	CDestroyStaticDataBuffer(PCHandle pStaticDataBuffer) {
 		_CSyncLeaveErr(FALSE, "CDestroyStaticDataBuffer failed because pStaticDataBuffer was invalid");
 	}
 
-	if (TryEnterCriticalSection(&sdBuff->mapLock) == FALSE) {
+	if (sdBuff->mapped != NULL) {
 		_CSyncLeaveErr(FALSE, "CDestroyStaticDataBuffer failed because buffer is currently mapped");
 	}
 
 	// free data
-	DeleteCriticalSection(&sdBuff->mapLock);
+	// note: draws still reading the current version keep it alive
+	DeleteCriticalSection(&sdBuff->versionLock);
+	CInternalStaticDataVersionRelease(sdBuff->current);
 	CInternalFree(sdBuff->name);
-	CInternalFree(sdBuff->data);
 	CInternalFree(sdBuff);
 
 	// set handle to NULL
@@ -213,10 +227,17 @@ CSMCALL PVOID	CStaticDataBufferMap(CHandle sdBuffer) {
 		_CSyncLeaveErr(NULL, "CStaticDataBufferMap failed because sdBuffer was invalid");
 	}
 
+	// only one writer at a time
 	PCStaticDataBuffer sdBuff = sdBuffer;
-	EnterCriticalSection(&sdBuff->mapLock); // lock data
+	if (sdBuff->mapped != NULL) {
+		_CSyncLeaveErr(NULL, "CStaticDataBufferMap failed because sdBuffer was already mapped");
+	}
 
-	_CSyncLeave(sdBuff->data);
+	// write into a copy so that draws never see partial writes
+	sdBuff->mapped = _makeVersion(sdBuff->sizeBytes);
+	COPY_BYTES(sdBuff->current->data, sdBuff->mapped->data, sdBuff->sizeBytes);
+
+	_CSyncLeave(sdBuff->mapped->data);
 }
 
 CSMCALL void	CStaticDataBufferUnmap(CHandle sdBuffer) {
@@ -227,7 +248,18 @@ CSMCALL void	CStaticDataBufferUnmap(CHandle sdBuffer) {
 	}
 
 	PCStaticDataBuffer sdBuff = sdBuffer;
-	LeaveCriticalSection(&sdBuff->mapLock); // lock data
+	if (sdBuff->mapped == NULL) {
+		_CSyncLeaveErr(NULL, "CStaticDataBufferUnmap failed because sdBuffer was not mapped");
+	}
+
+	// publish written copy
+	EnterCriticalSection(&sdBuff->versionLock);
+	PCStaticDataVersion oldVersion = sdBuff->current;
+	sdBuff->current = sdBuff->mapped;
+	LeaveCriticalSection(&sdBuff->versionLock);
+
+	sdBuff->mapped = NULL;
+	CInternalStaticDataVersionRelease(oldVersion);
 
 	_CSyncLeave(NULL);
 }
@@ -242,4 +274,18 @@ CSMCALL SIZE_T	CStaticDataBufferGetSizeBytes(CHandle sdBuffer) {
 	PCStaticDataBuffer sdBuff = sdBuffer;
 
 	_CSyncLeave(sdBuff->sizeBytes);
-}
\ No newline at end of file
+}
+
+PCStaticDataVersion CInternalStaticDataBufferPin(PCStaticDataBuffer sdBuffer) {
+	EnterCriticalSection(&sdBuffer->versionLock);
+	PCStaticDataVersion version = sdBuffer->current;
+	InterlockedIncrement(&version->refCount);
+	LeaveCriticalSection(&sdBuffer->versionLock);
+
+	return version;
+}
+
+void CInternalStaticDataVersionRelease(PCStaticDataVersion version) {
+	if (InterlockedDecrement(&version->refCount) == 0)
+		CInternalFree(version);
+}
@@ -17,11 +17,20 @@ typedef struct CVertexDataBuffer {
 	PFLOAT data;
 } CVertexDataBuffer, *PCVertexDataBuffer;
 
+// immutable snapshot of static data
+// note: freed once neither the buffer nor any draw references it
+typedef struct CStaticDataVersion {
+	volatile LONG refCount;
+	BYTE		  data[];
+} CStaticDataVersion, *PCStaticDataVersion;
+
+// note: mapped is only touched under the global lock, which also keeps one writer at a time
 typedef struct CStaticDataBuffer {
-	CRITICAL_SECTION mapLock;
-	PCHAR  name;
-	SIZE_T sizeBytes;
-	PVOID  data;
+	CRITICAL_SECTION	versionLock; // held briefly to swap or pin the current version
+	PCHAR				name;
+	SIZE_T				sizeBytes;
+	PCStaticDataVersion current;
+	PCStaticDataVersion mapped;		 // written between map and unmap, published on unmap
 } CStaticDataBuffer, *PCStaticDataBuffer;
 
 CSMCALL CHandle CMakeVertexDataBuffer(PCHAR name, UINT32 elementCount, 
@@ -39,6 +48,9 @@ CSMCALL UINT32	CVertexDataBufferGetComponentCount(CHandle vdBuffer);
 CSMCALL CHandle CMakeStaticDataBuffer(PCHAR name, SIZE_T sizeBytes,
 	PVOID dataIn);
 CSMCALL BOOL	CDestroyStaticDataBuffer(PCHandle pStaticDataBuffer);
+// note: map returns a copy of the current data, draws in flight keep reading the
+// version they started with and draws after unmap see the new data
+// note: fails while the buffer is already mapped, and mapped buffers can't be destroyed
 CSMCALL PVOID	CStaticDataBufferMap(CHandle sdBuffer);
 CSMCALL void	CStaticDataBufferUnmap(CHandle sdBuffer);
 CSMCALL SIZE_T	CStaticDataBufferGetSizeBytes(CHandle sdBuffer);
@@ -0,0 +1,246 @@
+// <csm_commandlist.c>
+// Bailey Jia-Tao Brown
+// 2023
+
+#include "csmint.h"
+#include "csmint_pipeline.h"
+#include "csm_commandlist.h"
+#include <stdlib.h>
+
+static __forceinline PCDrawInput _makeInputTable(PCIArena arena) {
+	PCDrawInput inputs = CInternalArenaAlloc(arena, sizeof(CDrawInput) * CSM_MAX_DRAW_INPUTS);
+	ZERO_BYTES(inputs, sizeof(CDrawInput) * CSM_MAX_DRAW_INPUTS);
+	return inputs;
+}
+
+CSMCALL CHandle CMakeCommandList(void) {
+	_CSyncEnter();
+
+	PCCommandList list = CInternalAlloc(sizeof(CCommandList));
+	InitializeCriticalSection(&list->recordLock);
+	list->arena  = CInternalMakeArena();
+	list->inputs = _makeInputTable(list->arena);
+
+	_CSyncLeave(list);
+}
+
+CSMCALL BOOL	CDestroyCommandList(CHandle commandList) {
+	_CSyncEnter();
+	if (commandList == NULL) {
+		_CSyncLeaveErr(FALSE, "CDestroyCommandList failed because commandList was invalid");
+	}
+
+	PCCommandList list = commandList;
+
+	if (TryEnterCriticalSection(&list->recordLock) == FALSE) {
+		_CSyncLeaveErr(FALSE, "CDestroyCommandList failed because commandList is being recorded");
+	}
+	LeaveCriticalSection(&list->recordLock);
+
+	// free all memory
+	DeleteCriticalSection(&list->recordLock);
+	if (list->commands != NULL)
+		CInternalFree(list->commands);
+	CInternalDestroyArena(list->arena);
+	CInternalFree(list);
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL BOOL	CCommandListReset(CHandle commandList) {
+	if (commandList == NULL) {
+		CInternalSetLastError("CCommandListReset failed because commandList was invalid");
+		return FALSE;
+	}
+
+	PCCommandList list = commandList;
+	EnterCriticalSection(&list->recordLock);
+
+	// note: draw inputs are cleared along with the commands
+	CInternalArenaReset(list->arena);
+	list->commandCount = 0;
+	list->inputs	   = _makeInputTable(list->arena);
+	list->inputsShared = FALSE;
+
+	LeaveCriticalSection(&list->recordLock);
+	return TRUE;
+}
+
+CSMCALL BOOL	CCommandListSetDrawInput(CHandle commandList, UINT32 inputID, PVOID inBytes, SIZE_T size) {
+	if (commandList == NULL) {
+		CInternalSetLastError("CCommandListSetDrawInput failed because commandList was invalid");
+		return FALSE;
+	}
+	if (inputID >= CSM_MAX_DRAW_INPUTS) {
+		CInternalSetLastError("CCommandListSetDrawInput failed because inputID was invalid");
+		return FALSE;
+	}
+	if (inBytes == NULL && size != 0) {
+		CInternalSetLastError("CCommandListSetDrawInput failed because inBytes was NULL");
+		return FALSE;
+	}
+
+	PCCommandList list = commandList;
+	EnterCriticalSection(&list->recordLock);
+
+	// recorded draws keep the table they were recorded with
+	if (list->inputsShared) {
+		PCDrawInput inputs = CInternalArenaAlloc(list->arena, sizeof(CDrawInput) * CSM_MAX_DRAW_INPUTS);
+		COPY_BYTES(list->inputs, inputs, sizeof(CDrawInput) * CSM_MAX_DRAW_INPUTS);
+		list->inputs	   = inputs;
+		list->inputsShared = FALSE;
+	}
+
+	// copy data, old data stays alive in the arena until reset
+	PCDrawInput input = list->inputs + inputID;
+	input->sizeBytes = size;
+	input->pData	 = NULL;
+	if (size != 0) {
+		input->pData = CInternalArenaAlloc(list->arena, size);
+		COPY_BYTES(inBytes, input->pData, size);
+	}
+
+	LeaveCriticalSection(&list->recordLock);
+	return TRUE;
+}
+
+CSMCALL BOOL	CCommandListDraw(CHandle commandList, CHandle rClass, UINT32 instanceCount,
+	FLOAT sortDepth, BOOL transparent) {
+	if (commandList == NULL) {
+		CInternalSetLastError("CCommandListDraw failed because commandList was invalid");
+		return FALSE;
+	}
+	if (rClass == NULL) {
+		CInternalSetLastError("CCommandListDraw failed because rClass was invalid");
+		return FALSE;
+	}
+	if (instanceCount == 0) {
+		CInternalSetLastError("CCommandListDraw failed because instanceCount was 0");
+		return FALSE;
+	}
+
+	PCCommandList list = commandList;
+	EnterCriticalSection(&list->recordLock);
+
+	// grow command array if needed
+	if (list->commandCount == list->commandCapacity) {
+		UINT32 newCapacity = max(0x40, list->commandCapacity * 2);
+		PCDrawCommand newCommands = CInternalAllocUnzeroed(sizeof(CDrawCommand) * newCapacity);
+		if (list->commands != NULL) {
+			COPY_BYTES(list->commands, newCommands, sizeof(CDrawCommand) * list->commandCount);
+			CInternalFree(list->commands);
+		}
+		list->commands		  = newCommands;
+		list->commandCapacity = newCapacity;
+	}
+
+	PCDrawCommand command  = list->commands + list->commandCount;
+	command->rClass		   = rClass;
+	command->instanceCount = instanceCount;
+	command->sortDepth	   = sortDepth;
+	command->transparent   = transparent;
+	command->inputs		   = list->inputs;
+	command->recordID	   = list->commandCount;
+	list->commandCount++;
+	list->inputsShared = TRUE;
+
+	LeaveCriticalSection(&list->recordLock);
+	return TRUE;
+}
+
+CSMCALL UINT32	CCommandListGetCommandCount(CHandle commandList) {
+	if (commandList == NULL) {
+		CInternalSetLastError("CCommandListGetCommandCount failed because commandList was invalid");
+		return 0;
+	}
+
+	PCCommandList list = commandList;
+	EnterCriticalSection(&list->recordLock);
+	UINT32 commandCount = list->commandCount;
+	LeaveCriticalSection(&list->recordLock);
+
+	return commandCount;
+}
+
+// maps float bits so that unsigned order matches float order
+static __forceinline UINT32 _depthSortBits(FLOAT depth) {
+	UINT32 bits = *(PUINT32)&depth;
+	return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+}
+
+static __forceinline UINT64 _makeSortKey(PCDrawCommand command) {
+	PCRenderClass pClass = command->rClass;
+
+	// opaque draws go nearest first, which is the largest depth
+	UINT32 depthBits = _depthSortBits(command->sortDepth);
+	if (command->transparent == FALSE) depthBits = ~depthBits;
+
+	// depth is quantized so that draws at nearly the same depth group by material
+	UINT64 key = (UINT64)(command->transparent ? 1 : 0) << 63;
+	key |= (UINT64)(depthBits >> 8) << 39;
+	key |= ((UINT64)((ULONG_PTR)pClass->materials[0] >> 4) & 0x7FFFFF) << 16;
+	return key;
+}
+
+static int _compareCommands(const void* a, const void* b) {
+	const CDrawCommand* commandA = a;
+	const CDrawCommand* commandB = b;
+
+	if (commandA->sortKey != commandB->sortKey)
+		return (commandA->sortKey < commandB->sortKey) ? -1 : 1;
+	if (commandA->recordID != commandB->recordID)
+		return (commandA->recordID < commandB->recordID) ? -1 : 1;
+	return 0;
+}
+
+CSMCALL BOOL	CSubmitCommandList(CHandle drawContext, CHandle commandList) {
+	_CSyncEnter();
+
+	// get start tick
+	LARGE_INTEGER counterStartTick;
+	QueryPerformanceCounter(&counterStartTick);
+
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(FALSE, "CSubmitCommandList failed because drawContext was invalid");
+	}
+	if (commandList == NULL) {
+		_CSyncLeaveErr(FALSE, "CSubmitCommandList failed because commandList was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	PCCommandList list	  = commandList;
+	if (context->asyncPending > 0) {
+		_CSyncLeaveErr(FALSE, "CSubmitCommandList failed because drawContext has unfinished async draws");
+	}
+
+	// recording waits until the whole list is drawn, as draws read its commands and inputs
+	// note: recorders never take the global lock, so waiting while holding it is safe
+	EnterCriticalSection(&list->recordLock);
+
+	// sort commands
+	// note: commands were validated when recorded
+	for (UINT32 commandID = 0; commandID < list->commandCount; commandID++)
+		list->commands[commandID].sortKey = _makeSortKey(list->commands + commandID);
+	qsort(list->commands, list->commandCount, sizeof(CDrawCommand), _compareCommands);
+
+	// draw all commands in order without the global lock
+	CInternalGlobalUnlock();
+	for (UINT32 commandID = 0; commandID < list->commandCount; commandID++) {
+		PCDrawCommand command = list->commands + commandID;
+		CInternalDrawInstanced(context, command->rClass, command->instanceCount, command->inputs);
+	}
+	CInternalGlobalLock();
+
+	LeaveCriticalSection(&list->recordLock);
+
+	// get end tick
+	LARGE_INTEGER counterEndTick;
+	QueryPerformanceCounter(&counterEndTick);
+
+	// time of the whole list is reported as the last draw time
+	LONGLONG counterTicksElapsed = counterEndTick.QuadPart - counterStartTick.QuadPart;
+	LONGLONG elapsedMS = (counterTicksElapsed / _csmint.perfCounterHzMs.QuadPart);
+	context->lastDrawTimeMS = (UINT64)elapsedMS;
+
+	_CSyncLeave(TRUE);
+}
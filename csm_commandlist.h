@@ -0,0 +1,45 @@
+// <csm_commandlist.h>
+// Bailey Jia-Tao Brown
+// 2023
+
+#ifndef _CSM_COMMANDLIST_INCLUDE_
+#define _CSM_COMMANDLIST_INCLUDE_
+
+#include "csm_draw.h"
+
+typedef struct CDrawCommand {
+	CHandle		rClass;
+	UINT32		instanceCount;
+	FLOAT		sortDepth;		// same convention as render buffer depth, larger is nearer
+	BOOL		transparent;	// drawn after all opaque draws, back to front
+	PCDrawInput	inputs;			// snapshot of the list's draw inputs when recorded
+	UINT32		recordID;		// keeps draws with equal keys in recording order
+	UINT64		sortKey;		// generated on submit
+} CDrawCommand, *PCDrawCommand;
+
+// note: recording only takes the list's own lock, so several threads may record at
+// once, recording while the list is submitted waits until the submit is done
+typedef struct CCommandList {
+	CRITICAL_SECTION recordLock;
+	CHandle			 arena;			// input snapshots, rewound on reset
+	PCDrawCommand	 commands;
+	UINT32			 commandCount;
+	UINT32			 commandCapacity;
+	PCDrawInput		 inputs;		// current inputs, copied on write once a draw uses them
+	BOOL			 inputsShared;
+} CCommandList, *PCCommandList;
+
+CSMCALL CHandle CMakeCommandList(void);
+CSMCALL BOOL	CDestroyCommandList(CHandle commandList);
+CSMCALL BOOL	CCommandListReset(CHandle commandList);
+CSMCALL BOOL	CCommandListSetDrawInput(CHandle commandList, UINT32 inputID, PVOID inBytes, SIZE_T size);
+CSMCALL BOOL	CCommandListDraw(CHandle commandList, CHandle rClass, UINT32 instanceCount,
+	FLOAT sortDepth, BOOL transparent);
+CSMCALL UINT32	CCommandListGetCommandCount(CHandle commandList);
+
+// draws are sorted opaque front to back, then by material, then transparent back to front
+// note: validated and sorted under the global lock, then drawn without it while the
+// list's record lock is held
+CSMCALL BOOL	CSubmitCommandList(CHandle drawContext, CHandle commandList);
+
+#endif
@@ -7,6 +7,51 @@
 #include "csm_draw.h"
 #include "csm_mesh.h"
 #include <stdio.h>
+#include <limits.h>
+
+static void _releaseVisDraws(PCIPVisState vis) {
+	for (PCIPVisDraw draw = vis->draws; draw != NULL; draw = draw->next) {
+		for (UINT32 sdID = 0; sdID < CSM_CLASS_MAX_STATIC_DATA; sdID++) {
+			if (draw->staticData[sdID] != NULL)
+				CInternalStaticDataVersionRelease(draw->staticData[sdID]);
+		}
+	}
+
+	CInternalArenaReset(vis->arena);
+	vis->draws		= NULL;
+	vis->dirty.minX = vis->dirty.minY = INT_MAX;
+	vis->dirty.maxX = vis->dirty.maxY = -1;
+}
+
+static void _resolveVisDraws(PCDrawContext context) {
+	PCIPVisState vis = context->visState;
+	if (vis == NULL || vis->draws == NULL) return;
+
+	// shading scratch is taken from the frame arena, as no draw is running
+	PCIArena arena = context->frameArena;
+	CInternalArenaReset(arena);
+
+	// every record carries its draw, so the context only needs what all draws share
+	PCIPTriContext tContext = CInternalArenaAlloc(arena, sizeof(CIPTriContext));
+	ZERO_BYTES(tContext, sizeof(CIPTriContext));
+	tContext->drawContext		  = context;
+	tContext->renderBuffer		  = context->renderBuffer;
+	tContext->fragContext.parent  = tContext;
+	tContext->scissor			  = vis->dirty;
+	tContext->depthTest			  = context->depthTest;
+	tContext->visBuffer			  = context->visBuffer;
+	tContext->vis				  = vis;
+
+	// only pixels drawn to since the last resolve are walked
+	if (vis->dirty.maxX >= vis->dirty.minX) {
+		if (context->backend == CDrawBackend_Tiled)
+			CInternalPipelineResolveVisBands(arena, tContext);
+		else
+			CInternalPipelineResolveVisBuffer(tContext);
+	}
+
+	_releaseVisDraws(vis);
+}
 
 CSMCALL CHandle CMakeDrawContext(CHandle renderBuffer) {
 	_CSyncEnter();
@@ -16,6 +61,7 @@ CSMCALL CHandle CMakeDrawContext(CHandle renderBuffer) {
 
 	PCDrawContext dc = CInternalAlloc(sizeof(CDrawContext));
 	dc->renderBuffer = renderBuffer;
+	dc->frameArena = CInternalMakeArena();
 
 	_CSyncLeave(dc);
 }
@@ -27,6 +73,9 @@ CSMCALL BOOL	CDestroyDrawContext(CHandle drawContext) {
 	}
 
 	PCDrawContext context = drawContext;
+	if (context->asyncPending > 0) {
+		_CSyncLeaveErr(FALSE, "CDestroyDrawContext failed because drawContext has unfinished async draws");
+	}
 
 	// free all input data
 	for (UINT32 inputID = 0; inputID < CSM_MAX_DRAW_INPUTS; inputID++) {
@@ -35,19 +84,30 @@ CSMCALL BOOL	CDestroyDrawContext(CHandle drawContext) {
 			CInternalFree(input->pData);
 	}
 
-	// free dc
+	// unresolved visibility buffer draws are dropped
+	PCIPVisState vis = context->visState;
+	if (vis != NULL) {
+		_releaseVisDraws(vis);
+		CInternalDestroyArena(vis->arena);
+		CInternalFree(vis);
+	}
+
+	// free scratch memory and dc
+	if (context->visBuffer != NULL)
+		CInternalFree(context->visBuffer);
+	CInternalDestroyArena(context->frameArena);
 	CInternalFree(context);
 
 	_CSyncLeave(TRUE);
 }
 
 CSMCALL	CHandle	CDrawContextSetDrawInput(CHandle drawContext, UINT32 inputID, PVOID inBytes, SIZE_T size) {
-	_CSyncEnter();
+	_CCallEnter();
 	if (drawContext == NULL) {
-		_CSyncLeaveErr(FALSE, "CDrawContextSetDrawInput failed because drawContext was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextSetDrawInput failed because drawContext was invalid");
 	}
 	if (inputID >= CSM_MAX_DRAW_INPUTS) {
-		_CSyncLeaveErr(FALSE, "CDrawContextSetDrawInput failed because inputID was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextSetDrawInput failed because inputID was invalid");
 	}
 
 	PCDrawContext context = drawContext;
@@ -59,27 +119,27 @@ CSMCALL	CHandle	CDrawContextSetDrawInput(CHandle drawContext, UINT32 inputID, PV
 
 	// if size is 0, then skip
 	if (size == 0) {
-		_CSyncLeave(TRUE);
+		_CCallLeave(TRUE);
 	}
 
 	// alloc new and copy
-	input->pData = CInternalAlloc(size);
+	input->pData = CInternalAllocUnzeroed(size);
 	input->sizeBytes = size;
 	COPY_BYTES(inBytes, input->pData, size);
 
-	_CSyncLeave(TRUE);
+	_CCallLeave(TRUE);
 }
 
 CSMCALL BOOL	CDrawContextGetDrawInput(CHandle drawContext, UINT32 inputID, PVOID outBytes) {
-	_CSyncEnter();
+	_CCallEnter();
 	if (drawContext == NULL) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetDrawInput failed because drawContext was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextGetDrawInput failed because drawContext was invalid");
 	}
 	if (inputID >= CSM_MAX_DRAW_INPUTS) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetDrawInput failed because inputID was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextGetDrawInput failed because inputID was invalid");
 	}
 	if (outBytes == NULL) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetDrawInput failed because outBytes was NULL");
+		_CCallLeaveErr(FALSE, "CDrawContextGetDrawInput failed because outBytes was NULL");
 	}
 
 	PCDrawContext context = drawContext;
@@ -88,32 +148,161 @@ CSMCALL BOOL	CDrawContextGetDrawInput(CHandle drawContext, UINT32 inputID, PVOID
 	// copy bytes to outbuffer
 	COPY_BYTES(input->pData, outBytes, input->sizeBytes);
 
-	_CSyncLeave(TRUE);
+	_CCallLeave(TRUE);
 }
 
 CSMCALL SIZE_T	CDrawContextGetDrawInputSizeBytes(CHandle drawContext, UINT32 inputID) {
-	_CSyncEnter();
+	_CCallEnter();
 	if (drawContext == NULL) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetDrawInputSizeBytes failed because drawContext was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextGetDrawInputSizeBytes failed because drawContext was invalid");
 	}
 	if (inputID >= CSM_MAX_DRAW_INPUTS) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetDrawInputSizeBytes failed because inputID was invalid");
+		_CCallLeaveErr(FALSE, "CDrawContextGetDrawInputSizeBytes failed because inputID was invalid");
 	}
 
 	PCDrawContext context = drawContext;
 	PCDrawInput input = context->inputs + inputID;
 
-	_CSyncLeave(input->sizeBytes);
+	_CCallLeave(input->sizeBytes);
 }
 
 CSMCALL UINT64	CDrawContextGetLastDrawTimeMS(CHandle drawContext) {
+	_CCallEnter();
+	if (drawContext == NULL) {
+		_CCallLeaveErr(FALSE, "CDrawContextGetLastDrawTimeMS failed because drawContext was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	_CCallLeave(context->lastDrawTimeMS);
+}
+
+CSMCALL BOOL	CDrawContextSetBackend(CHandle drawContext, CDrawBackend backend) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetBackend failed because drawContext was invalid");
+	}
+	if (backend >= CDrawBackend_Error) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetBackend failed because backend was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	context->backend = backend;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL CDrawBackend CDrawContextGetBackend(CHandle drawContext) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(CDrawBackend_Error, "CDrawContextGetBackend failed because drawContext was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	_CSyncLeave(context->backend);
+}
+
+CSMCALL BOOL	CDrawContextSetMode(CHandle drawContext, CDrawMode mode) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetMode failed because drawContext was invalid");
+	}
+	if (mode >= CDrawMode_Error) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetMode failed because mode was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+
+	// pending visibility buffer draws are shaded before other modes draw over them
+	if (context->mode == CDrawMode_VisibilityBuffer && mode != CDrawMode_VisibilityBuffer) {
+		if (context->asyncPending > 0) {
+			_CSyncLeaveErr(FALSE, "CDrawContextSetMode failed because drawContext has unfinished async draws");
+		}
+
+		CInternalGlobalUnlock();
+		_resolveVisDraws(context);
+		CInternalGlobalLock();
+	}
+
+	context->mode = mode;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL CDrawMode CDrawContextGetMode(CHandle drawContext) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(CDrawMode_Error, "CDrawContextGetMode failed because drawContext was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	_CSyncLeave(context->mode);
+}
+
+CSMCALL BOOL	CDrawContextSetDepthTest(CHandle drawContext, CDepthTest depthTest) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetDepthTest failed because drawContext was invalid");
+	}
+	if (depthTest >= CDepthTest_Error) {
+		_CSyncLeaveErr(FALSE, "CDrawContextSetDepthTest failed because depthTest was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	context->depthTest = depthTest;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL CDepthTest CDrawContextGetDepthTest(CHandle drawContext) {
 	_CSyncEnter();
 	if (drawContext == NULL) {
-		_CSyncLeaveErr(FALSE, "CDrawContextGetLastDrawTimeMS failed because drawContext was invalid");
+		_CSyncLeaveErr(CDepthTest_Error, "CDrawContextGetDepthTest failed because drawContext was invalid");
 	}
 
 	PCDrawContext context = drawContext;
-	_CSyncLeave(context->lastDrawTimeMS);
+	_CSyncLeave(context->depthTest);
+}
+
+CSMCALL BOOL	CDrawContextResolve(CHandle drawContext) {
+	_CSyncEnter();
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(FALSE, "CDrawContextResolve failed because drawContext was invalid");
+	}
+
+	PCDrawContext context = drawContext;
+	if (context->asyncPending > 0) {
+		_CSyncLeaveErr(FALSE, "CDrawContextResolve failed because drawContext has unfinished async draws");
+	}
+
+	// shade without the global lock, like a draw
+	CInternalGlobalUnlock();
+	_resolveVisDraws(context);
+	CInternalGlobalLock();
+
+	_CSyncLeave(TRUE);
+}
+
+static __forceinline void _drawScreenTri(PCIPTriContext tContext, PCIPBinContext binContext,
+	PCIPTriData tri) {
+	// project triangle
+	CInternalPipelineProjectTri(tContext->renderBuffer, tri);
+
+	// defer to tile workers
+	if (binContext != NULL) {
+		CInternalPipelineBinTri(binContext, tContext, tri);
+		return;
+	}
+
+	// visible pixels refer back to the triangle, so it must outlive the draw
+	if (tContext->vis != NULL) {
+		CIPRect bounds;
+		if (CInternalPipelineTriBounds(tContext->renderBuffer, tri, &bounds) == FALSE) return;
+
+		tContext->visRecord = CInternalPipelineRecordVisTri(tContext, tri, bounds);
+		tri = tContext->visRecord->tri;
+	}
+
+	CInternalPipelineRasterizeTri(tContext, tri);
 }
 
 CSMCALL BOOL CDraw(CHandle drawContext, CHandle rClass) {
@@ -138,79 +327,259 @@ CSMCALL BOOL CDrawInstanced(CHandle drawContext, CHandle rClass, UINT32 instance
 		_CSyncLeaveErr(FALSE, "CDrawInstanced failed because instanceCount was 0");
 	}
 
-	// copy of class
-	PCRenderClass pClass = rClass;
+	PCDrawContext context = drawContext;
+	if (context->asyncPending > 0) {
+		_CSyncLeaveErr(FALSE, "CDrawInstanced failed because drawContext has unfinished async draws");
+	}
+
+	// draw without the global lock so that other threads may draw at the same time
+	CInternalGlobalUnlock();
+	CInternalDrawInstanced(context, rClass, instanceCount, context->inputs);
+	CInternalGlobalLock();
+
+	// get end tick
+	LARGE_INTEGER counterEndTick;
+	QueryPerformanceCounter(&counterEndTick);
+
+	// calculate elapsed time
+	LONGLONG counterTicksElapsed = counterEndTick.QuadPart - counterStartTick.QuadPart;
+
+	// convert to MS
+	LONGLONG elapsedMS = (counterTicksElapsed / _csmint.perfCounterHzMs.QuadPart);
+	context->lastDrawTimeMS = (UINT64)elapsedMS;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL CHandle CDrawInstancedAsync(CHandle drawContext, CHandle rClass, UINT32 instanceCount) {
+	_CSyncEnter();
+
+	// check for bad params
+	if (drawContext == NULL) {
+		_CSyncLeaveErr(NULL, "CDrawInstancedAsync failed because drawContext was invalid");
+	}
+	if (rClass == NULL) {
+		_CSyncLeaveErr(NULL, "CDrawInstancedAsync failed because rClass was invalid");
+	}
+	if (instanceCount == 0) {
+		_CSyncLeaveErr(NULL, "CDrawInstancedAsync failed because instanceCount was 0");
+	}
 
-	// get context and render buffer
 	PCDrawContext context = drawContext;
+
+	// make fence
+	PCFence fence = CInternalAlloc(sizeof(CFence));
+	fence->signalEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	// capture inputs by value so they may be changed for the next draw right away
+	PCIRenderJob job = CInternalAlloc(sizeof(CIRenderJob));
+	job->drawContext   = context;
+	job->rClass		   = rClass;
+	job->instanceCount = instanceCount;
+	job->fence		   = fence;
+	for (UINT32 inputID = 0; inputID < CSM_MAX_DRAW_INPUTS; inputID++) {
+		PCDrawInput input = context->inputs + inputID;
+		if (input->pData == NULL || input->sizeBytes == 0) continue;
+
+		job->inputs[inputID].pData	   = CInternalAllocUnzeroed(input->sizeBytes);
+		job->inputs[inputID].sizeBytes = input->sizeBytes;
+		COPY_BYTES(input->pData, job->inputs[inputID].pData, input->sizeBytes);
+	}
+
+	CInternalRenderThreadQueue(job);
+
+	_CSyncLeave(fence);
+}
+
+CSMCALL BOOL	CFencePoll(CHandle fence) {
+	if (fence == NULL) {
+		CInternalSetLastError("CFencePoll failed because fence was invalid");
+		return FALSE;
+	}
+
+	PCFence pFence = fence;
+	return pFence->signaled;
+}
+
+CSMCALL BOOL	CFenceWait(CHandle fence) {
+	if (fence == NULL) {
+		CInternalSetLastError("CFenceWait failed because fence was invalid");
+		return FALSE;
+	}
+
+	// note: never takes the global lock, the render thread needs it to finish
+	PCFence pFence = fence;
+	WaitForSingleObject(pFence->signalEvent, INFINITE);
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CDestroyFence(CHandle fence) {
+	if (fence == NULL) {
+		CInternalSetLastError("CDestroyFence failed because fence was invalid");
+		return FALSE;
+	}
+
+	PCFence pFence = fence;
+	WaitForSingleObject(pFence->signalEvent, INFINITE);
+
+	CloseHandle(pFence->signalEvent);
+	CInternalFree(pFence);
+
+	return TRUE;
+}
+
+static void _bindVertexStreams(PCIArena arena, PCIPTriContext tContext) {
+	PCMesh mesh = tContext->rClass->mesh;
+
+	for (UINT32 streamID = 0; streamID < CSM_CLASS_MAX_VERTEX_DATA; streamID++) {
+		PCVertexDataBuffer vdb = CInternalRenderClassGetVertexDataBuffer(tContext->rClass, streamID);
+		if (vdb == NULL) continue;
+
+		PCVertexStream stream = tContext->vertexStreams + streamID;
+		stream->data	   = vdb->data;
+		stream->stride	   = vdb->elementComponents;
+		stream->components = vdb->elementComponents;
+
+		// buffers shorter than the mesh roll over, so they are unrolled to cover every vertex
+		if (vdb->elementCount < mesh->vertCount) {
+			SIZE_T elemSizeBytes = sizeof(FLOAT) * vdb->elementComponents;
+			PBYTE  unrolled		 = CInternalArenaAlloc(arena, elemSizeBytes * mesh->vertCount);
+			for (UINT32 vertexID = 0; vertexID < mesh->vertCount; vertexID++) {
+				COPY_BYTES(
+					vdb->data + ((vertexID % vdb->elementCount) * vdb->elementComponents),
+					unrolled + (elemSizeBytes * vertexID),
+					elemSizeBytes);
+			}
+			stream->data = (const FLOAT*)unrolled;
+		}
+	}
+}
+
+static PCIPVisState _recordVisDraw(PCDrawContext context, PCIPTriContext tContext) {
+	// made on first use
+	if (context->visState == NULL) {
+		PCIPVisState vis = CInternalAlloc(sizeof(CIPVisState));
+		vis->arena = CInternalMakeArena();
+		_releaseVisDraws(vis);
+		context->visState = vis;
+	}
+	PCIPVisState vis = context->visState;
+
+	// the draw is shaded after it returns, so its inputs are copied and its
+	// static data stays pinned
+	PCIPVisDraw draw = CInternalArenaAlloc(vis->arena, sizeof(CIPVisDraw));
+	draw->rClass		= tContext->rClass;
+	draw->layoutSource	= NULL;
+	draw->drawInputs	= CInternalArenaAlloc(vis->arena, sizeof(CDrawInput) * CSM_MAX_DRAW_INPUTS);
+	for (UINT32 inputID = 0; inputID < CSM_MAX_DRAW_INPUTS; inputID++) {
+		PCDrawInput input = tContext->drawInputs + inputID;
+		PCDrawInput copy  = draw->drawInputs + inputID;
+		copy->sizeBytes = input->sizeBytes;
+		copy->pData		= NULL;
+		if (input->pData == NULL || input->sizeBytes == 0) continue;
+
+		copy->pData = CInternalArenaAlloc(vis->arena, input->sizeBytes);
+		COPY_BYTES(input->pData, copy->pData, input->sizeBytes);
+	}
+	COPY_BYTES(tContext->staticData, draw->staticData, sizeof(draw->staticData));
+
+	draw->next = vis->draws;
+	vis->draws = draw;
+	return vis;
+}
+
+void CInternalDrawInstanced(PCDrawContext context, PCRenderClass pClass, UINT32 instanceCount,
+	PCDrawInput inputs) {
+	// get render buffer
 	PCRenderBuffer renderBuffer = context->renderBuffer;
 
+	// reset scratch memory from the last draw
+	PCIArena arena = context->frameArena;
+	CInternalArenaReset(arena);
+
+	// all pipeline scratch is carved from the arena once per draw and reused for
+	// every triangle so that no heap allocations happen per triangle
+	// note: triangles are sized for the most varyings a draw can have
+	const SIZE_T triSize = CSMINT_TRI_DATA_SIZE(CSMINT_MAX_VARYING_FLOATS);
+	PCIPTriData triData = CInternalArenaAlloc(arena, triSize);
+	PCIPTriData clippedTris[2] = {
+		CInternalArenaAlloc(arena, triSize),
+		CInternalArenaAlloc(arena, triSize)
+	};
+
+	// generate tri context for rasterization
+	// note: tContext->fragContext is untouched because it is determined per-fragment
+	// note: with the exception of tContext->fragContext.parent which points to tContext
+	PCIPTriContext tContext = CInternalArenaAlloc(arena, sizeof(CIPTriContext));
+	ZERO_BYTES(tContext, sizeof(CIPTriContext));
+	tContext->drawContext			= context;
+	tContext->drawInputs			= inputs;
+	tContext->rClass				= pClass;
+	tContext->renderBuffer			= renderBuffer;
+	tContext->fragContext.parent	= tContext;
+	tContext->scissor.maxX			= renderBuffer->width  - 1;
+	tContext->scissor.maxY			= renderBuffer->height - 1;
+
+	// depth only draws skip the fragment stage entirely
+	tContext->depthOnly = (context->mode == CDrawMode_DepthOnly);
+	tContext->depthTest = tContext->depthOnly ? CDepthTest_Greater : context->depthTest;
+
+	// vertex data streams are bound once so that fetches need no checks
+	_bindVertexStreams(arena, tContext);
+
+	// static data is read from the same version for the whole draw
+	for (UINT32 sdID = 0; sdID < CSM_CLASS_MAX_STATIC_DATA; sdID++) {
+		PCStaticDataBuffer sdb = CInternalRenderClassGetStaticDataBuffer(pClass, sdID);
+		if (sdb != NULL) tContext->staticData[sdID] = CInternalStaticDataBufferPin(sdb);
+	}
+
+	// visibility buffer starts empty and is emptied again by every resolve
+	if (context->mode == CDrawMode_VisibilityBuffer) {
+		if (context->visBuffer == NULL) {
+			SIZE_T pixelCount = (SIZE_T)renderBuffer->width * renderBuffer->height;
+			context->visBuffer = CInternalAlloc(sizeof(PCIPTriRecord) * pixelCount);
+		}
+		tContext->visBuffer = context->visBuffer;
+		tContext->vis		= _recordVisDraw(context, tContext);
+	}
+
+	// tiled backend collects screen triangles into bins instead of drawing them
+	PCIPBinContext binContext = NULL;
+	if (context->backend == CDrawBackend_Tiled)
+		binContext = CInternalPipelineBeginBinning(arena, tContext);
+
+	// get mesh
+	PCMesh drawMesh = pClass->mesh;
+
+	// shaded vertices are cached so shared vertices are only shaded once per instance
+	tContext->vertCache = CInternalPipelineMakeVertCache(arena, pClass);
+
 	// loop all instances
 	for (UINT32 instanceID = 0; instanceID < instanceCount; instanceID++) {
-		// get mesh
-		PCMesh drawMesh = CRenderClassGetMesh(rClass);
-
 		// loop each triangle of mesh and rasterize triangle
-		// this is done by walking indexes in groups of 3
-		UINT32 triangleID = 0;
-		for (UINT32 meshIndex = 0; meshIndex < drawMesh->indexCount; meshIndex += 3) {
-			// alloc triangle to heap
-			PCIPTriData triData = CInternalAlloc(sizeof(CIPTriData));
-
-			// get triangle from mesh
-			triData->verts[0] = 
-				drawMesh->vertArray[drawMesh->indexArray[meshIndex + 0]];
-			triData->verts[1] =
-				drawMesh->vertArray[drawMesh->indexArray[meshIndex + 1]];
-			triData->verts[2] =
-				drawMesh->vertArray[drawMesh->indexArray[meshIndex + 2]];
-
-			// generate tri context for rasterization
-			// note: tContext->fragContext is untouched because it is determined per-fragment
-			// note: with the exception of tContext->fragContext.parent which points to tContext
-			PCIPTriContext tContext = CInternalAlloc(sizeof(CIPTriContext));
-			tContext->drawContext			= drawContext;
+		// each triangle indexes the mesh in groups of 3
+		for (UINT32 triangleID = 0; triangleID < drawMesh->triCount; triangleID++) {
+			// update per-triangle context values
 			tContext->instanceID			= instanceID;
 			tContext->triangleID			= triangleID;
-			tContext->rClass				= rClass;
-			tContext->renderBuffer			= renderBuffer;
-			tContext->fragContext.parent	= tContext;
 			tContext->screenTriAndData = triData; // temporary, will be replaced when clipped
 
 			// setup material
-			if (pClass->singleMaterial == TRUE) {
-				tContext->material = pClass->materials[0];
-			}
-			else {
-				tContext->material = pClass->materials[pClass->triMaterials[triangleID]];
-					
-				// set to default material
-				if (tContext->material == NULL) {
-					tContext->material = pClass->materials[0];
-				}
-
-				// check for bad state
-				if (tContext->material == NULL) {
-					CInternalErrorPopup("Bad material state. No materials exist in class.");
-				}
+			tContext->materialSlot	= CInternalPipelineResolveMaterialSlot(pClass, triangleID);
+			tContext->material		= pClass->materials[tContext->materialSlot];
+
+			// check for bad state
+			if (tContext->material == NULL) {
+				CInternalErrorPopup("Bad material state. No materials exist in class.");
 			}
 
 			// process triangle vertex inputs/outputs
 			CInternalPipelineProcessTri(tContext, triData);
 			
-
 			// clip triangle
-			PCIPTriData clippedTris = CInternalAlloc(sizeof(CIPTriData) * 2);
 			UINT32 triCount = CInternalPipelineClipTri(triData, clippedTris);
 
-			// setup materials
-			PCRenderClass tempRClass = rClass;
-			tContext->material = tempRClass->materials[tempRClass->triMaterials[triangleID]];
-
-			// if material is NULL, use default material (0)
-			if (tContext->material == NULL)
-				tContext->material = tempRClass->materials[0];
-
 			// change based on clip output
 			switch (triCount)
 			{
@@ -218,67 +587,36 @@ CSMCALL BOOL CDrawInstanced(CHandle drawContext, CHandle rClass, UINT32 instance
 				break;
 
 			case 0: // default case. no extra tris used
-				// project triangle
-				CInternalPipelineProjectTri(renderBuffer, triData);
-
-				// rasterize triangle
-				CInternalPipelineRasterizeTri(tContext, triData);
-
+				_drawScreenTri(tContext, binContext, triData);
 				break;
 
 			case 1: // clipped original tri into 1 tri
-				// project triangle
-				CInternalPipelineProjectTri(renderBuffer, clippedTris + 0);
-
-				// rasterize clipped triangle
-				CInternalPipelineRasterizeTri(tContext, clippedTris + 0);
-
+				_drawScreenTri(tContext, binContext, clippedTris[0]);
 				break;
 
 			case 2: // clipped original tri into 2 tris
-				// project triangle 1
-				CInternalPipelineProjectTri(renderBuffer, clippedTris + 0);
-
-				// rasterize clipped triangle 1
-				CInternalPipelineRasterizeTri(tContext, clippedTris + 0);
-
-				// project triangle 2
-				CInternalPipelineProjectTri(renderBuffer, clippedTris + 1);
-
-				// rasterize triangle 2
-				CInternalPipelineRasterizeTri(tContext, clippedTris + 1);
-
+				_drawScreenTri(tContext, binContext, clippedTris[0]);
+				_drawScreenTri(tContext, binContext, clippedTris[1]);
 				break;
 
 			default:
 				CInternalErrorPopup("Bad clipping state");
 				break;
 			}
-
-			// free extra triangles
-			CInternalFree(clippedTris);
-
-			// free triangle data
-			CInternalFree(triData);
-
-			// free triangle context
-			CInternalFree(tContext);
-
-			// increment triangleID
-			triangleID++;
 		}
 	}
 
-	// get end tick
-	LARGE_INTEGER counterEndTick;
-	QueryPerformanceCounter(&counterEndTick);
-
-	// calculate elapsed time
-	LONGLONG counterTicksElapsed = counterEndTick.QuadPart - counterStartTick.QuadPart;
+	// rasterize all tiles in parallel
+	if (binContext != NULL) {
+		CInternalPipelineRasterizeBins(binContext);
+	}
 
-	// convert to MS
-	LONGLONG elapsedMS = (counterTicksElapsed / _csmint.perfCounterHzMs.QuadPart);
-	context->lastDrawTimeMS = (UINT64)elapsedMS;
+	// visibility buffer draws keep their static data until resolved
+	if (tContext->vis != NULL) return;
 
-	_CSyncLeave(TRUE);
+	// release static data
+	for (UINT32 sdID = 0; sdID < CSM_CLASS_MAX_STATIC_DATA; sdID++) {
+		if (tContext->staticData[sdID] != NULL)
+			CInternalStaticDataVersionRelease(tContext->staticData[sdID]);
+	}
 }
\ No newline at end of file
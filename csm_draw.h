@@ -14,10 +14,49 @@ typedef struct CDrawInput {
 	PVOID	pData;
 } CDrawInput, *PCDrawInput;
 
+typedef enum CDrawBackend {
+	CDrawBackend_Serial,	// rasterize each triangle on the calling thread
+	CDrawBackend_Tiled,		// bin triangles into screen tiles and rasterize tiles in parallel
+	CDrawBackend_Error
+} CDrawBackend, *PCDrawBackend;
+
+typedef enum CDrawMode {
+	CDrawMode_Forward,			// shade every fragment that passes the depth test
+	CDrawMode_VisibilityBuffer,	// resolve visibility first, then shade each covered pixel once
+	CDrawMode_DepthOnly,		// write depth only, no fragment shading or color
+	CDrawMode_Error
+} CDrawMode, *PCDrawMode;
+// note: in visibility buffer mode depth is written before shading, so fragments that
+// the fragment shader discards still occlude, and blending is against the color from
+// before the first draw since the last resolve
+// note: visibility buffer draws are only shaded by CDrawContextResolve, or when the
+// mode is changed, so that pixels drawn over by several draws are shaded once
+// note: depth only draws always use CDepthTest_Greater
+
+typedef enum CDepthTest {
+	CDepthTest_Greater,	// pass when nearer than the stored depth, depth is written
+	CDepthTest_Equal,	// pass when matching the stored depth, depth is left untouched
+	CDepthTest_Error
+} CDepthTest, *PCDepthTest;
+// note: CDepthTest_Equal is meant for shading after a depth only pass of the same geometry
+
+// signaled once an async draw has finished
+typedef struct CFence {
+	HANDLE		  signalEvent;
+	volatile LONG signaled;
+} CFence, *PCFence;
+
 typedef struct CDrawContext {
-	CHandle		renderBuffer;
-	CDrawInput	inputs[CSM_MAX_DRAW_INPUTS];
-	UINT64		lastDrawTimeMS;
+	CHandle		 renderBuffer;
+	CDrawInput	 inputs[CSM_MAX_DRAW_INPUTS];
+	UINT64		 lastDrawTimeMS;
+	CHandle		 frameArena; // per-draw pipeline scratch, reset every draw
+	CDrawBackend backend;
+	CDrawMode	 mode;
+	CDepthTest	 depthTest;
+	CHandle		 visBuffer;  // per-pixel visible triangle, allocated on first use
+	CHandle		 visState;	 // draws waiting for a resolve, made on first use
+	volatile LONG asyncPending; // async draws not yet finished
 } CDrawContext, *PCDrawContext;
 
 CSMCALL CHandle CMakeDrawContext(CHandle renderBuffer);
@@ -27,9 +66,38 @@ CSMCALL	CHandle	CDrawContextSetDrawInput(CHandle drawContext, UINT32 inputID, PV
 CSMCALL BOOL	CDrawContextGetDrawInput(CHandle drawContext, UINT32 inputID, PVOID outBytes);
 CSMCALL SIZE_T	CDrawContextGetDrawInputSizeBytes(CHandle drawContext, UINT32 inputID);
 CSMCALL UINT64	CDrawContextGetLastDrawTimeMS(CHandle drawContext);
+CSMCALL BOOL	CDrawContextSetBackend(CHandle drawContext, CDrawBackend backend);
+CSMCALL CDrawBackend CDrawContextGetBackend(CHandle drawContext);
+CSMCALL BOOL	CDrawContextSetMode(CHandle drawContext, CDrawMode mode);
+CSMCALL CDrawMode CDrawContextGetMode(CHandle drawContext);
+CSMCALL BOOL	CDrawContextSetDepthTest(CHandle drawContext, CDepthTest depthTest);
+CSMCALL CDepthTest CDrawContextGetDepthTest(CHandle drawContext);
 
+// shades every pixel drawn in visibility buffer mode since the last resolve
+// note: call once all of a frame's draws are done, before the render buffer is read,
+// presented or cleared. classes and materials must still be valid
+CSMCALL BOOL	CDrawContextResolve(CHandle drawContext);
+
+// threading: draws don't hold the global lock while drawing, so several threads may
+// draw at once as long as each uses its own draw context and render buffer
+// note: classes, materials, meshes and vertex data buffers must not be changed or
+// destroyed while being drawn. static data buffers may be mapped at any time, draws
+// keep reading the version that was current when they started, see <csm_buffer.h>
+// note: tiled draws share one worker pool, so only one runs at a time
+// note: draw inputs, render buffer fragments and clears skip the global lock, and
+// errors are kept per thread, so errors raised by shaders stay on the shading thread
 CSMCALL BOOL CDraw(CHandle drawContext, CHandle rClass);
 CSMCALL BOOL CDrawInstanced(CHandle drawContext, CHandle rClass,
 	UINT32 instanceCount);
 
+// queues the draw on the render thread and returns a fence for it
+// note: draw inputs are copied when queued, other draw context state is read when the
+// draw runs. async draws run in order, and drawContext can't be drawn to synchronously
+// or destroyed until they have finished
+CSMCALL CHandle CDrawInstancedAsync(CHandle drawContext, CHandle rClass,
+	UINT32 instanceCount);
+CSMCALL BOOL	CFencePoll(CHandle fence); // TRUE when signaled
+CSMCALL BOOL	CFenceWait(CHandle fence);
+CSMCALL BOOL	CDestroyFence(CHandle fence); // waits for the fence first
+
 #endif
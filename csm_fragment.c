@@ -22,6 +22,10 @@ static __forceinline void _clampFloatToColorRange(PFLOAT f) {
 	);
 }
 
+static __forceinline PCStaticDataBuffer _getStaticDataBuffer(PCIPFragContext context, UINT32 ID) {
+	return CInternalRenderClassGetStaticDataBuffer(context->parent->rClass, ID);
+}
+
 CSMCALL CColor	CFragmentConvertFloat3ToColor(FLOAT r, FLOAT g, FLOAT b) {
 	_clampFloatToColorRange(&r);
 	_clampFloatToColorRange(&g);
@@ -127,7 +131,7 @@ CSMCALL BOOL	CFragmentGetDrawInput(CHandle fragContext, UINT32 drawInputID, PVOI
 
 	PCIPFragContext context = fragContext;
 
-	PCDrawInput drawInput = context->parent->drawContext->inputs + drawInputID;
+	PCDrawInput drawInput = context->parent->drawInputs + drawInputID;
 	COPY_BYTES(drawInput->pData, outBuffer, drawInput->sizeBytes);
 
 	return TRUE;
@@ -144,7 +148,7 @@ CSMCALL PVOID	CFragmentUnsafeGetDrawInputDirect(CHandle fragContext, UINT32 draw
 	}
 
 	PCIPFragContext context = fragContext;
-	return context->parent->drawContext->inputs[drawInputID].pData;
+	return context->parent->drawInputs[drawInputID].pData;
 }
 
 CSMCALL SIZE_T	CFragmentGetDrawInputSizeBytes(CHandle fragContext, UINT32 drawInputID) {
@@ -159,11 +163,34 @@ CSMCALL SIZE_T	CFragmentGetDrawInputSizeBytes(CHandle fragContext, UINT32 drawIn
 
 	PCIPFragContext context = fragContext;
 
-	PCDrawInput drawInput = context->parent->drawContext->inputs + drawInputID;
+	PCDrawInput drawInput = context->parent->drawInputs + drawInputID;
 
 	return drawInput->sizeBytes;
 }
 
+// derivatives of one output, interpolated the same way as the output itself
+static __forceinline void _getOutputDerivatives(PCIPFragContext context, UINT32 outputID,
+	PFLOAT ddxOut, PFLOAT ddyOut) {
+	CInternalPipelineQuadDerivatives(context);
+
+	PCIPTriData tri	   = context->parent->screenTriAndData;
+	UINT32		offset = context->varyings->offsets[outputID];
+	PFLOAT values[3] = {
+		CSMINT_TRI_VARYINGS(tri, 0) + offset,
+		CSMINT_TRI_VARYINGS(tri, 1) + offset,
+		CSMINT_TRI_VARYINGS(tri, 2) + offset
+	};
+
+	CVect3F dx = context->quadWeightsDX;
+	CVect3F dy = context->quadWeightsDY;
+	for (UINT32 component = 0; component < context->varyings->componentCounts[outputID]; component++) {
+		ddxOut[component] = values[0][component] * dx.x + values[1][component] * dx.y +
+			values[2][component] * dx.z;
+		ddyOut[component] = values[0][component] * dy.x + values[1][component] * dy.y +
+			values[2][component] * dy.z;
+	}
+}
+
 CSMCALL BOOL	CFragmentGetVertexOutput(CHandle fragContext, UINT32 outputID, PFLOAT outBuffer) {
 	if (outBuffer == NULL) {
 		CInternalSetLastError("CFragmentGetVertexOutput failed because outBuffer was NULL");
@@ -180,8 +207,10 @@ CSMCALL BOOL	CFragmentGetVertexOutput(CHandle fragContext, UINT32 outputID, PFLO
 
 	PCIPFragContext context = fragContext;
 
-	COPY_BYTES(context->fragInputs.outputs[outputID].valueBuffer, outBuffer,
-		sizeof(FLOAT) * context->fragInputs.outputs[outputID].componentCount);
+	// inputs are packed, so find the output's offset
+	PCIPVaryingLayout varyings = context->varyings;
+	COPY_BYTES(context->fragInputs + varyings->offsets[outputID], outBuffer,
+		sizeof(FLOAT) * varyings->componentCounts[outputID]);
 
 	return TRUE;
 }
@@ -197,7 +226,7 @@ CSMCALL PFLOAT	CFragmentUnsafeGetVertexOutputDirect(CHandle fragContext, UINT32
 	}
 
 	PCIPFragContext context = fragContext;
-	return context->fragInputs.outputs[outputID].valueBuffer;
+	return context->fragInputs + context->varyings->offsets[outputID];
 }
 
 CSMCALL UINT32	CFragmentGetVertexOutputComponentCount(CHandle fragContext, UINT32 outputID) {
@@ -212,7 +241,44 @@ CSMCALL UINT32	CFragmentGetVertexOutputComponentCount(CHandle fragContext, UINT3
 
 	PCIPFragContext context = fragContext;
 
-	return context->fragInputs.outputs[outputID].componentCount;
+	return context->varyings->componentCounts[outputID];
+}
+
+CSMCALL BOOL	CFragmentGetVertexOutputDerivatives(CHandle fragContext, UINT32 outputID,
+	PFLOAT ddxOut, PFLOAT ddyOut) {
+	if (fragContext == NULL) {
+		CInternalSetLastError("CFragmentGetVertexOutputDerivatives failed because fragContext was invalid");
+		return FALSE;
+	}
+	if (ddxOut == NULL || ddyOut == NULL) {
+		CInternalSetLastError("CFragmentGetVertexOutputDerivatives failed because an out buffer was NULL");
+		return FALSE;
+	}
+	if (outputID >= CSM_MAX_VERTEX_OUTPUTS) {
+		CInternalSetLastError("CFragmentGetVertexOutputDerivatives failed because outputID was invalid");
+		return FALSE;
+	}
+
+	PCIPFragContext context = fragContext;
+	_getOutputDerivatives(context, outputID, ddxOut, ddyOut);
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CFragmentSetOutputFloat4(CHandle fragContext, FLOAT r, FLOAT g, FLOAT b, FLOAT a) {
+	if (fragContext == NULL) {
+		CInternalSetLastError("CFragmentSetOutputFloat4 failed because fragContext was invalid");
+		return FALSE;
+	}
+
+	PCIPFragContext context = fragContext;
+	context->outputIsFloat = TRUE;
+	context->outputFloat.x = r;
+	context->outputFloat.y = g;
+	context->outputFloat.z = b;
+	context->outputFloat.w = a;
+
+	return TRUE;
 }
 
 CSMCALL BOOL	CFragmentGetClassStaticData(CHandle fragContext, UINT32 ID, PVOID outBuffer) {
@@ -227,20 +293,34 @@ CSMCALL BOOL	CFragmentGetClassStaticData(CHandle fragContext, UINT32 ID, PVOID o
 
 	PCIPFragContext context = fragContext;
 
-	PCStaticDataBuffer sdb = CRenderClassGetStaticDataBuffer(context->parent->rClass, ID);
+	PCStaticDataBuffer sdb = _getStaticDataBuffer(context, ID);
 	if (sdb == NULL) {
 		CInternalSetLastError("CFragmentGetClassStaticData failed because ID was invalid");
 		return FALSE;
 	}
 
-	// copy to outbuffer
-	EnterCriticalSection(&sdb->mapLock);
-	COPY_BYTES(sdb->data, outBuffer, sdb->sizeBytes);
-	LeaveCriticalSection(&sdb->mapLock);
+	// copy to outbuffer from the version pinned by the draw
+	COPY_BYTES(context->parent->staticData[ID]->data, outBuffer, sdb->sizeBytes);
 
 	return TRUE;
 }
 
+CSMCALL PVOID	CFragmentGetClassStaticDataDirect(CHandle fragContext, UINT32 ID) {
+	if (fragContext == NULL) {
+		CInternalSetLastError("CFragmentGetClassStaticDataDirect failed because fragContext was invalid");
+		return NULL;
+	}
+
+	PCIPFragContext context = fragContext;
+
+	if (_getStaticDataBuffer(context, ID) == NULL) {
+		CInternalSetLastError("CFragmentGetClassStaticDataDirect failed because ID was invalid");
+		return NULL;
+	}
+
+	return context->parent->staticData[ID]->data;
+}
+
 CSMCALL SIZE_T	CFragmentGetClassStaticDataSizeBytes(CHandle fragContext, UINT32 ID) {
 	if (fragContext == NULL) {
 		CInternalSetLastError("CFragmentGetClassStaticDataSizeBytes failed because fragContext was invalid");
@@ -249,7 +329,7 @@ CSMCALL SIZE_T	CFragmentGetClassStaticDataSizeBytes(CHandle fragContext, UINT32
 
 	PCIPFragContext context = fragContext;
 
-	PCStaticDataBuffer sdb = CRenderClassGetStaticDataBuffer(context->parent->rClass, ID);
+	PCStaticDataBuffer sdb = _getStaticDataBuffer(context, ID);
 	if (sdb == NULL) {
 		CInternalSetLastError("CFragmentGetClassStaticDataSizeBytes failed because ID was invalid");
 		return FALSE;
@@ -320,8 +400,169 @@ CSMCALL BOOL	CFragmentSampleRenderBuffer(PCColor inOutColor, CHandle renderBuffe
 	fb_x = max(0, min(fb_x, texWidth  - 1));
 	fb_y = max(0, min(fb_y, texHeight - 1));
 
-	FLOAT unusedDepth;
-	CRenderBufferUnsafeGetFragment(renderBuffer, fb_x, fb_y, inOutColor, &unusedDepth);
+	// note: tiles that still owe a clear read as the transparent default
+	if (rb->tileClear[CSMINT_RB_TILE_ID(rb, fb_x, fb_y)] & CSMINT_RB_CLEAR_COLOR) {
+		*inOutColor = CMakeColor4(0, 0, 0, 0);
+		return TRUE;
+	}
+
+	if (rb->colorFormat == CColorFormat_BGRA8)
+		*inOutColor = ((PCColor)rb->color)[CSMINT_RB_PIXEL_INDEX(rb, fb_x, fb_y)];
+	else
+		*inOutColor = CInternalRenderBufferReadColor(rb, fb_x, fb_y);
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CFragmentSampleTexture(CHandle fragContext, PCColor colorOut, CHandle texture,
+	UINT32 uvOutputID, CSampleType sampleType, CTextureFilter filter) {
+	if (fragContext == NULL) {
+		CInternalSetLastError("CFragmentSampleTexture failed because fragContext was invalid");
+		return FALSE;
+	}
+	if (colorOut == NULL) {
+		CInternalSetLastError("CFragmentSampleTexture failed because colorOut was NULL");
+		return FALSE;
+	}
+	if (texture == NULL) {
+		CInternalSetLastError("CFragmentSampleTexture failed because texture was invalid");
+		return FALSE;
+	}
+	if (uvOutputID >= CSM_MAX_VERTEX_OUTPUTS) {
+		CInternalSetLastError("CFragmentSampleTexture failed because uvOutputID was invalid");
+		return FALSE;
+	}
+	if (sampleType >= CSampleType_Error) {
+		CInternalSetLastError("CFragmentSampleTexture failed because sampleType was invalid");
+		return FALSE;
+	}
+	if (filter >= CTextureFilter_Error) {
+		CInternalSetLastError("CFragmentSampleTexture failed because filter was invalid");
+		return FALSE;
+	}
+
+	PCIPFragContext context = fragContext;
+	if (context->varyings->componentCounts[uvOutputID] < 2) {
+		CInternalSetLastError("CFragmentSampleTexture failed because uv output had less than 2 components");
+		return FALSE;
+	}
+
+	// note: derivatives are only needed when there is more than one level to pick from
+	PCTexture pTexture = texture;
+	PFLOAT	  uvIn	   = context->fragInputs + context->varyings->offsets[uvOutputID];
+	FLOAT	  lod	   = 0.0f;
+	if (pTexture->levelCount > 1) {
+		FLOAT ddx[CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS];
+		FLOAT ddy[CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS];
+		_getOutputDerivatives(context, uvOutputID, ddx, ddy);
+		lod = CInternalTextureFindLod(pTexture, CMakeVect2F(ddx[0], ddx[1]), CMakeVect2F(ddy[0], ddy[1]));
+	}
+
+	*colorOut = CInternalTextureSample(pTexture, CMakeVect2F(uvIn[0], uvIn[1]), lod, sampleType, filter);
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CFragmentSampleTextureGrad(PCColor colorOut, CHandle texture, CVect2F uv,
+	CVect2F uvDX, CVect2F uvDY, CSampleType sampleType, CTextureFilter filter) {
+	if (colorOut == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureGrad failed because colorOut was NULL");
+		return FALSE;
+	}
+	if (texture == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureGrad failed because texture was invalid");
+		return FALSE;
+	}
+	if (sampleType >= CSampleType_Error) {
+		CInternalSetLastError("CFragmentSampleTextureGrad failed because sampleType was invalid");
+		return FALSE;
+	}
+	if (filter >= CTextureFilter_Error) {
+		CInternalSetLastError("CFragmentSampleTextureGrad failed because filter was invalid");
+		return FALSE;
+	}
+
+	PCTexture pTexture = texture;
+	FLOAT lod = CInternalTextureFindLod(pTexture, uvDX, uvDY);
+	*colorOut = CInternalTextureSample(pTexture, uv, lod, sampleType, filter);
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CFragmentSampleTextureBatch(PCColor colorsOut, CHandle texture, const CVect2F* uvs,
+	UINT32 count, CVect2F uvDX, CVect2F uvDY, CSampleType sampleType, CTextureFilter filter) {
+	if (colorsOut == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureBatch failed because colorsOut was NULL");
+		return FALSE;
+	}
+	if (texture == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureBatch failed because texture was invalid");
+		return FALSE;
+	}
+	if (uvs == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureBatch failed because uvs was NULL");
+		return FALSE;
+	}
+	if (sampleType >= CSampleType_Error) {
+		CInternalSetLastError("CFragmentSampleTextureBatch failed because sampleType was invalid");
+		return FALSE;
+	}
+	if (filter >= CTextureFilter_Error) {
+		CInternalSetLastError("CFragmentSampleTextureBatch failed because filter was invalid");
+		return FALSE;
+	}
+
+	PCTexture pTexture = texture;
+	FLOAT lod = CInternalTextureFindLod(pTexture, uvDX, uvDY);
+
+	UINT32 sample = 0;
+	for (; sample + 4 <= count; sample += 4)
+		CInternalTextureSample4(pTexture, uvs + sample, lod, sampleType, filter, colorsOut + sample);
+
+	// pad leftover uvs with the last one, then keep only their colors
+	if (sample < count) {
+		CVect2F tailUVs[4];
+		CColor	tailColors[4];
+		for (UINT32 lane = 0; lane < 4; lane++)
+			tailUVs[lane] = uvs[min(sample + lane, count - 1)];
+
+		CInternalTextureSample4(pTexture, tailUVs, lod, sampleType, filter, tailColors);
+		COPY_BYTES(tailColors, colorsOut + sample, sizeof(CColor) * (count - sample));
+	}
+
+	return TRUE;
+}
+
+CSMCALL BOOL	CFragmentSampleTextureQuad(PCColor colorsOut, CHandle texture, const CVect2F* quadUVs,
+	CSampleType sampleType, CTextureFilter filter) {
+	if (colorsOut == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureQuad failed because colorsOut was NULL");
+		return FALSE;
+	}
+	if (texture == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureQuad failed because texture was invalid");
+		return FALSE;
+	}
+	if (quadUVs == NULL) {
+		CInternalSetLastError("CFragmentSampleTextureQuad failed because quadUVs was NULL");
+		return FALSE;
+	}
+	if (sampleType >= CSampleType_Error) {
+		CInternalSetLastError("CFragmentSampleTextureQuad failed because sampleType was invalid");
+		return FALSE;
+	}
+	if (filter >= CTextureFilter_Error) {
+		CInternalSetLastError("CFragmentSampleTextureQuad failed because filter was invalid");
+		return FALSE;
+	}
+
+	// quad neighbours give the uv change per pixel, like the quad derivatives of vertex outputs
+	PCTexture pTexture = texture;
+	CVect2F uvDX = CMakeVect2F(quadUVs[1].x - quadUVs[0].x, quadUVs[1].y - quadUVs[0].y);
+	CVect2F uvDY = CMakeVect2F(quadUVs[2].x - quadUVs[0].x, quadUVs[2].y - quadUVs[0].y);
+	FLOAT lod = CInternalTextureFindLod(pTexture, uvDX, uvDY);
+
+	CInternalTextureSample4(pTexture, quadUVs, lod, sampleType, filter, colorsOut);
 
 	return TRUE;
 }
@@ -6,11 +6,13 @@
 #define _CSM_FRAGMENT_INCLUDE_
 
 #include "csm_renderclass.h"
+#include "csm_texture.h"
 
 typedef enum CSampleType {
 	CSampleType_Clamp,
 	CSampleType_ClampToEdge,
-	CSampleType_Repeat
+	CSampleType_Repeat,
+	CSampleType_Error
 } CSampleType;
 
 CSMCALL CColor	CFragmentConvertFloat3ToColor(FLOAT r, FLOAT g, FLOAT b);
@@ -30,11 +32,36 @@ CSMCALL SIZE_T	CFragmentGetDrawInputSizeBytes(CHandle fragContext, UINT32 drawIn
 CSMCALL BOOL	CFragmentGetVertexOutput(CHandle fragContext, UINT32 outputID, PFLOAT outBuffer);
 CSMCALL PFLOAT	CFragmentUnsafeGetVertexOutputDirect(CHandle fragContext, UINT32 outputID);
 CSMCALL UINT32	CFragmentGetVertexOutputComponentCount(CHandle fragContext, UINT32 outputID);
+// change of each component per pixel in x and y, shared by the 2x2 pixel quad of the fragment
+CSMCALL BOOL	CFragmentGetVertexOutputDerivatives(CHandle fragContext, UINT32 outputID,
+	PFLOAT ddxOut, PFLOAT ddyOut);
+
+// note: replaces the color the shader outputs, same scale as CFragmentConvertFloat4ToColor
+// note: float render buffers keep it unclamped, others convert it to CColor
+CSMCALL BOOL	CFragmentSetOutputFloat4(CHandle fragContext, FLOAT r, FLOAT g, FLOAT b, FLOAT a);
 
 CSMCALL BOOL	CFragmentGetClassStaticData(CHandle fragContext, UINT32 ID, PVOID outBuffer);
 CSMCALL SIZE_T	CFragmentGetClassStaticDataSizeBytes(CHandle fragContext, UINT32 ID);
+// note: read only, stays valid and unchanged until the draw ends even if the buffer is remapped
+CSMCALL PVOID	CFragmentGetClassStaticDataDirect(CHandle fragContext, UINT32 ID);
 
 CSMCALL BOOL	CFragmentSampleRenderBuffer(PCColor inOutColor, CHandle renderBuffer, 
 	CVect2F uv, CSampleType sampleType);
 
+// uv is the first 2 components of a vertex output, its quad derivatives pick the mip level
+// note: clamped samples outside of the texture are fully transparent
+CSMCALL BOOL	CFragmentSampleTexture(CHandle fragContext, PCColor colorOut, CHandle texture,
+	UINT32 uvOutputID, CSampleType sampleType, CTextureFilter filter);
+// same as above with the uv change per pixel given, zero derivatives sample level 0
+CSMCALL BOOL	CFragmentSampleTextureGrad(PCColor colorOut, CHandle texture, CVect2F uv,
+	CVect2F uvDX, CVect2F uvDY, CSampleType sampleType, CTextureFilter filter);
+// samples count uvs 4 at a time, all sharing one uv change per pixel
+// note: same colors as sampling each uv with CFragmentSampleTextureGrad
+CSMCALL BOOL	CFragmentSampleTextureBatch(PCColor colorsOut, CHandle texture, const CVect2F* uvs,
+	UINT32 count, CVect2F uvDX, CVect2F uvDY, CSampleType sampleType, CTextureFilter filter);
+// samples a 2x2 pixel quad, uvs are for (x, y), (x + 1, y), (x, y + 1) and (x + 1, y + 1)
+// note: the uv change per pixel is found from the quad's own uvs
+CSMCALL BOOL	CFragmentSampleTextureQuad(PCColor colorsOut, CHandle texture, const CVect2F* quadUVs,
+	CSampleType sampleType, CTextureFilter filter);
+
 #endif
@@ -50,12 +50,12 @@ CSMCALL CHandle CMakeMesh(UINT32 vertexCount,
 
 	// calculate vertex data size and copy
 	const SIZE_T vertexDataSize = sizeof(CVect3F) * vertexCount;
-	mPtr->vertArray = CInternalAlloc(vertexDataSize);
+	mPtr->vertArray = CInternalAllocUnzeroed(vertexDataSize);
 	COPY_BYTES(vertPositionalArray, mPtr->vertArray, vertexDataSize);
 
 	// calculate indicies size and copy
 	const SIZE_T indexDataSize = sizeof(INT) * indexCount;
-	mPtr->indexArray = CInternalAlloc(indexDataSize);
+	mPtr->indexArray = CInternalAllocUnzeroed(indexDataSize);
 	COPY_BYTES(indexes, mPtr->indexArray, indexDataSize);
 
 	// set other data values
@@ -4,10 +4,16 @@
 
 #include "csmint.h"
 #include "csm_renderbuffer.h"
+#include "csm_fragment.h"
 #include <float.h>
 #include <stdio.h>
 #include <math.h>
 
+static __forceinline PVOID _alignPlane(PVOID memory) {
+	return (PVOID)(((ULONG_PTR)memory + CSM_RENDERBUFFER_PLANE_ALIGNMENT - 1) &
+		~(ULONG_PTR)(CSM_RENDERBUFFER_PLANE_ALIGNMENT - 1));
+}
+
 CSMCALL BOOL CMakeRenderBuffer(PCHandle pHandle, INT width, INT height) {
 	_CSyncEnter();
 
@@ -21,13 +27,70 @@ CSMCALL BOOL CMakeRenderBuffer(PCHandle pHandle, INT width, INT height) {
 		_CSyncLeave(FALSE);
 	}
 
-	PCRenderBuffer rb = CInternalAlloc(sizeof(CRenderBuffer));
-	rb->width = width;
-	rb->height = height;
-	rb->color = CInternalAlloc(sizeof(PCColor) * rb->width * rb->height + rb->height);
-	rb->depth = CInternalAlloc(sizeof(FLOAT) * rb->width * rb->height);
+	CRenderBufferDesc desc;
+	ZERO_BYTES(&desc, sizeof(desc));
+	desc.width	= width;
+	desc.height = height;
+	desc.layout = CRenderBufferLayout_Linear;
+
+	BOOL result = CMakeRenderBufferEx(pHandle, &desc);
+
+	_CSyncLeave(result);
+}
+
+CSMCALL BOOL CMakeRenderBufferEx(PCHandle pHandle, PCRenderBufferDesc desc) {
+	_CSyncEnter();
+
+	// check for bad params
+	if (pHandle == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because pHandle was NULL");
+	}
+	if (desc == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because desc was NULL");
+	}
+	if (desc->width < 1 || desc->height < 1) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because dimensions were invalid");
+	}
+	if (desc->layout >= CRenderBufferLayout_Error) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because layout was invalid");
+	}
+	if (desc->depthFormat >= CDepthFormat_Error) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because depthFormat was invalid");
+	}
+	if (desc->colorFormat >= CColorFormat_Error) {
+		_CSyncLeaveErr(FALSE, "CMakeRenderBufferEx failed because colorFormat was invalid");
+	}
 
-	// clear once
+	PCRenderBuffer rb = CInternalAlloc(sizeof(CRenderBuffer));
+	rb->width  = desc->width;
+	rb->height = desc->height;
+	rb->layout = desc->layout;
+	rb->depthFormat = desc->depthFormat;
+	rb->colorFormat = desc->colorFormat;
+	rb->dither		= desc->dither;
+
+	// make coarse depth blocks
+	rb->hizWidth  = (rb->width  + CSM_RENDERBUFFER_HIZ_BLOCK_SIZE - 1) / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	rb->hizHeight = (rb->height + CSM_RENDERBUFFER_HIZ_BLOCK_SIZE - 1) / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	rb->hizMin	  = CInternalAllocUnzeroed(sizeof(FLOAT) * rb->hizWidth * rb->hizHeight);
+	rb->hizMax	  = CInternalAllocUnzeroed(sizeof(FLOAT) * rb->hizWidth * rb->hizHeight);
+	rb->hizDirty  = CInternalAlloc(sizeof(BOOL)  * rb->hizWidth * rb->hizHeight);
+	rb->tileClear = CInternalAlloc(sizeof(BYTE)  * rb->hizWidth * rb->hizHeight);
+
+	// make planes, tiled planes hold every pixel of each edge tile
+	rb->planePixels = (SIZE_T)rb->width * rb->height;
+	if (rb->layout == CRenderBufferLayout_Tiled)
+		rb->planePixels = (SIZE_T)rb->hizWidth * rb->hizHeight *
+			CSM_RENDERBUFFER_HIZ_BLOCK_SIZE * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+
+	rb->colorMemory = CInternalAllocUnzeroed(CSMINT_COLOR_BYTES(rb->colorFormat) * rb->planePixels +
+		CSM_RENDERBUFFER_PLANE_ALIGNMENT);
+	rb->depthMemory = CInternalAllocUnzeroed(CSMINT_DEPTH_BYTES(rb->depthFormat) * rb->planePixels +
+		CSM_RENDERBUFFER_PLANE_ALIGNMENT);
+	rb->color = _alignPlane(rb->colorMemory);
+	rb->depth = _alignPlane(rb->depthMemory);
+
+	// clear once, which also covers the unzeroed planes
 	CRenderBufferClear(rb, TRUE, TRUE);
 
 	*pHandle = rb;
@@ -35,6 +98,42 @@ CSMCALL BOOL CMakeRenderBuffer(PCHandle pHandle, INT width, INT height) {
 	_CSyncLeave(TRUE);
 }
 
+CSMCALL CRenderBufferLayout CRenderBufferGetLayout(CHandle handle) {
+	_CSyncEnter();
+
+	if (handle == NULL) {
+		_CSyncLeaveErr(CRenderBufferLayout_Error, "CRenderBufferGetLayout failed because handle was invalid");
+	}
+
+	PCRenderBuffer pBuffer = handle;
+
+	_CSyncLeave(pBuffer->layout);
+}
+
+CSMCALL CDepthFormat CRenderBufferGetDepthFormat(CHandle handle) {
+	_CSyncEnter();
+
+	if (handle == NULL) {
+		_CSyncLeaveErr(CDepthFormat_Error, "CRenderBufferGetDepthFormat failed because handle was invalid");
+	}
+
+	PCRenderBuffer pBuffer = handle;
+
+	_CSyncLeave(pBuffer->depthFormat);
+}
+
+CSMCALL CColorFormat CRenderBufferGetColorFormat(CHandle handle) {
+	_CSyncEnter();
+
+	if (handle == NULL) {
+		_CSyncLeaveErr(CColorFormat_Error, "CRenderBufferGetColorFormat failed because handle was invalid");
+	}
+
+	PCRenderBuffer pBuffer = handle;
+
+	_CSyncLeave(pBuffer->colorFormat);
+}
+
 CSMCALL BOOL CDestroyRenderBuffer(PCHandle pHandle) {
 	_CSyncEnter();
 
@@ -50,8 +149,14 @@ CSMCALL BOOL CDestroyRenderBuffer(PCHandle pHandle) {
 	}
 
 	// free values
-	CInternalFree(buffer->color);
-	CInternalFree(buffer->depth);
+	CInternalFree(buffer->colorMemory);
+	CInternalFree(buffer->depthMemory);
+	if (buffer->presentColor != NULL)
+		CInternalFree(buffer->presentColor);
+	CInternalFree(buffer->hizMin);
+	CInternalFree(buffer->hizMax);
+	CInternalFree(buffer->hizDirty);
+	CInternalFree(buffer->tileClear);
 	CInternalFree(buffer);
 
 	*pHandle = NULL;
@@ -59,12 +164,167 @@ CSMCALL BOOL CDestroyRenderBuffer(PCHandle pHandle) {
 	_CSyncLeave(TRUE);
 }
 
+// note: color pointers are only valid as PCColor for CColorFormat_BGRA8
 static __forceinline PCColor _findColorPtr(PCRenderBuffer b, INT x, INT y) {
-	return b->color + (x + ((b->height - y - 1) * b->width));
+	return (PCColor)b->color + CSMINT_RB_PIXEL_INDEX(b, x, y);
 }
 
+static __forceinline PUINT16 _findColor565Ptr(PCRenderBuffer b, INT x, INT y) {
+	return (PUINT16)b->color + CSMINT_RB_PIXEL_INDEX(b, x, y);
+}
+
+static __forceinline PCVect4F _findColorFloatPtr(PCRenderBuffer b, INT x, INT y) {
+	return (PCVect4F)b->color + CSMINT_RB_PIXEL_INDEX(b, x, y);
+}
+
+// 4x4 ordered dither thresholds
+static const BYTE _ditherMatrix[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 }
+};
+
+static __forceinline UINT16 _encodeColor565(PCRenderBuffer b, INT x, INT y, CColor color) {
+	UINT32 r = color.r, g = color.g, b5 = color.b;
+
+	// spread the dropped bits over neighbouring pixels
+	if (b->dither) {
+		UINT32 threshold = _ditherMatrix[y & 3][x & 3];
+		r  = min(0xFF, r  + (threshold >> 1));
+		g  = min(0xFF, g  + (threshold >> 2));
+		b5 = min(0xFF, b5 + (threshold >> 1));
+	}
+
+	return (UINT16)(((r >> 3) << 11) | ((g >> 2) << 5) | (b5 >> 3));
+}
+
+static __forceinline CColor _decodeColor565(UINT16 color) {
+	UINT32 r = (color >> 11) & 0x1F;
+	UINT32 g = (color >> 5)  & 0x3F;
+	UINT32 b = color & 0x1F;
+	return CMakeColor4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255);
+}
+
+static __forceinline CColor _readColor(PCRenderBuffer b, INT x, INT y) {
+	switch (b->colorFormat)
+	{
+	case CColorFormat_RGB565:
+		return _decodeColor565(_findColor565Ptr(b, x, y)[0]);
+
+	case CColorFormat_RGBA32F:
+		return CFragmentConvertVect4ToColor(_findColorFloatPtr(b, x, y)[0]);
+
+	default:
+		return _findColorPtr(b, x, y)[0];
+	}
+}
+
+static __forceinline void _writeColor(PCRenderBuffer b, INT x, INT y, CColor color) {
+	switch (b->colorFormat)
+	{
+	case CColorFormat_RGB565:
+		_findColor565Ptr(b, x, y)[0] = _encodeColor565(b, x, y, color);
+		break;
+
+	case CColorFormat_RGBA32F:
+		_findColorFloatPtr(b, x, y)[0] = CFragmentConvertColorToVect4(color);
+		break;
+
+	default:
+		_findColorPtr(b, x, y)[0] = color;
+		break;
+	}
+}
+
+// note: depth pointers are only valid as PFLOAT for CDepthFormat_Float32
 static __forceinline PFLOAT _findDepthPtr(PCRenderBuffer b, INT x, INT y) {
-	return b->depth + (x + ((b->height - y - 1) * b->width));
+	return (PFLOAT)b->depth + CSMINT_RB_PIXEL_INDEX(b, x, y);
+}
+
+static __forceinline PUINT16 _findDepth16Ptr(PCRenderBuffer b, INT x, INT y) {
+	return (PUINT16)b->depth + CSMINT_RB_PIXEL_INDEX(b, x, y);
+}
+
+// rounds the same way as the span kernels
+static __forceinline UINT16 _encodeDepth16(FLOAT depth) {
+	FLOAT scaled = (depth - CSM_RENDERBUFFER_MAX_DEPTH) * CSMINT_DEPTH16_SCALE;
+	scaled = max(0.0f, min(scaled, CSMINT_DEPTH16_MAX));
+	return (UINT16)_mm_cvtss_si32(_mm_set_ss(scaled));
+}
+
+static __forceinline FLOAT _decodeDepth16(UINT16 depth) {
+	return ((FLOAT)depth / CSMINT_DEPTH16_SCALE) + CSM_RENDERBUFFER_MAX_DEPTH;
+}
+
+static __forceinline FLOAT _readDepth(PCRenderBuffer b, INT x, INT y) {
+	if (b->depthFormat == CDepthFormat_Unorm16)
+		return _decodeDepth16(_findDepth16Ptr(b, x, y)[0]);
+	return _findDepthPtr(b, x, y)[0];
+}
+
+static __forceinline UINT32 _findHiZBlock(PCRenderBuffer b, INT x, INT y) {
+	return (x / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE) +
+		((y / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE) * b->hizWidth);
+}
+
+static __forceinline BOOL _clearOwed(PCRenderBuffer b, INT x, INT y, BYTE plane) {
+	return (b->tileClear[CSMINT_RB_TILE_ID(b, x, y)] & plane) != 0;
+}
+
+// reads that see owed clears without filling them, so they never write
+static __forceinline CColor _readColorOrClear(PCRenderBuffer b, INT x, INT y) {
+	if (_clearOwed(b, x, y, CSMINT_RB_CLEAR_COLOR)) return CMakeColor4(0, 0, 0, 0);
+	return _readColor(b, x, y);
+}
+
+static __forceinline FLOAT _readDepthOrClear(PCRenderBuffer b, INT x, INT y) {
+	// note: 16 bit clear depth decodes back exactly
+	if (_clearOwed(b, x, y, CSMINT_RB_CLEAR_DEPTH)) return CSM_RENDERBUFFER_MAX_DEPTH;
+	return _readDepth(b, x, y);
+}
+
+static __forceinline BOOL _depthTest(PCRenderBuffer b, INT x, INT y, FLOAT newDepth) {
+	// 16 bit depth is tested in its own precision
+	if (b->depthFormat == CDepthFormat_Unorm16)
+		return _encodeDepth16(newDepth) > _findDepth16Ptr(b, x, y)[0];
+
+	// do depth test
+	FLOAT oldDepth;
+	oldDepth = _findDepthPtr(b, x, y)[0];
+	if (oldDepth - newDepth >= CSM_RENDERBUFFER_DEPTH_TEST_EPSILON) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void _resolveTile(PCRenderBuffer b, UINT32 tileID, BYTE planes) {
+	planes &= b->tileClear[tileID];
+	if (planes == 0) return;
+
+	// a tile row is contiguous in every layout
+	INT startX = (tileID % b->hizWidth) * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	INT startY = (tileID / b->hizWidth) * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	INT endY   = min((INT)b->height, startY + CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+	SIZE_T count = min((INT)b->width - startX, CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+
+	const FLOAT clearDepth = CSM_RENDERBUFFER_MAX_DEPTH;
+	for (INT y = startY; y < endY; y++) {
+		if (planes & CSMINT_RB_CLEAR_COLOR) {
+			SIZE_T colorBytes = CSMINT_COLOR_BYTES(b->colorFormat);
+			ZERO_BYTES((PBYTE)b->color + CSMINT_RB_PIXEL_INDEX(b, startX, y) * colorBytes,
+				colorBytes * count);
+		}
+		if (planes & CSMINT_RB_CLEAR_DEPTH) {
+			if (b->depthFormat == CDepthFormat_Unorm16)
+				__stosw(_findDepth16Ptr(b, startX, y), _encodeDepth16(clearDepth), count);
+			else
+				__stosd((PDWORD)_findDepthPtr(b, startX, y), *(PDWORD)&clearDepth, count);
+		}
+	}
+
+	b->tileClear[tileID] &= ~planes;
 }
 
 static __forceinline BOOL _checkPosInRB(PCRenderBuffer b, INT x, INT y) {
@@ -73,112 +333,223 @@ static __forceinline BOOL _checkPosInRB(PCRenderBuffer b, INT x, INT y) {
 
 CSMCALL BOOL CRenderBufferGetFragment(CHandle handle, INT x, INT y,
 	PCColor colorOut, PFLOAT depthOut) {
-	_CSyncEnter();
+	_CCallEnter();
 
 	if (handle == NULL) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferGetFragment failed because handle was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferGetFragment failed because handle was invalid");
 	}
 
 	PCRenderBuffer pBuffer = handle;
 	if (_checkPosInRB(pBuffer, x, y) == FALSE) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferGetFragment failed because position was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferGetFragment failed because position was invalid");
 	}
 
 
 	// no err raised for NULL(s)
 	if (colorOut != NULL) {
-		*colorOut = *(_findColorPtr(pBuffer, x, y));
+		*colorOut = _readColorOrClear(pBuffer, x, y);
 	}
 	if (depthOut != NULL) {
-		*depthOut = *(_findDepthPtr(pBuffer, x, y));
+		*depthOut = _readDepthOrClear(pBuffer, x, y);
 	}
 
-	_CSyncLeave(TRUE);
+	_CCallLeave(TRUE);
 }
 
 CSMCALL BOOL CRenderBufferSetFragment(CHandle handle, INT x, INT y,
 	CColor color, FLOAT depth) {
-	_CSyncEnter();
+	_CCallEnter();
 
 	if (handle == NULL) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferSetFragment failed because handle was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferSetFragment failed because handle was invalid");
 	}
 
 	PCRenderBuffer pBuffer = handle;
 	if (_checkPosInRB(pBuffer, x, y) == FALSE) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferSetFragment failed because position was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferSetFragment failed because position was invalid");
 	}
 
-	_CSyncLeave(CRenderBufferUnsafeSetFragment(pBuffer, x, y, color, depth));
+	_CCallLeave(CRenderBufferUnsafeSetFragment(pBuffer, x, y, color, depth));
 }
 
 CSMCALL BOOL CRenderBufferDepthTest(CHandle handle, INT x, INT y, FLOAT newDepth) {
+	_CCallEnter();
+
 	if (handle == NULL) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferDepthTest failed because handle was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferDepthTest failed because handle was invalid");
 	}
 
 	PCRenderBuffer pBuffer = handle;
 	if (_checkPosInRB(pBuffer, x, y) == FALSE) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferDepthTest failed because position was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferDepthTest failed because position was invalid");
 	}
 
 	// do depth test
-	_CSyncLeave(CRenderBufferUnsafeDepthTest(handle, x, y, newDepth));
+	_CCallLeave(CRenderBufferUnsafeDepthTest(handle, x, y, newDepth));
 }
 
 CSMCALL BOOL CRenderBufferClear(CHandle handle, BOOL color, BOOL depth) {
-	_CSyncEnter();
+	_CCallEnter();
 
 	if (handle == NULL) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferClear failed because pBuffer was invalid");
+		_CCallLeaveErr(FALSE, "CRenderBufferClear failed because pBuffer was invalid");
 	}
 	if (color == FALSE && depth == FALSE) {
-		_CSyncLeaveErr(FALSE, "CRenderBufferClear failed because both color and depth flag were false");
+		_CCallLeaveErr(FALSE, "CRenderBufferClear failed because both color and depth flag were false");
 	}
 
 	PCRenderBuffer pBuffer = handle;
-	INT elemCount = pBuffer->width * pBuffer->height;
-	
-	// set all colors to 0
-	if (color == TRUE)
-		__stosd(pBuffer->color, ZERO, elemCount);
+	INT blockCount = pBuffer->hizWidth * pBuffer->hizHeight;
+
+	// mark every tile, planes are filled per tile when first drawn to
+	BYTE planes = 0;
+	if (color == TRUE) planes |= CSMINT_RB_CLEAR_COLOR;
+	if (depth == TRUE) planes |= CSMINT_RB_CLEAR_DEPTH;
+	for (INT tileID = 0; tileID < blockCount; tileID++)
+		pBuffer->tileClear[tileID] |= planes;
 
-	// set all depth
+	// coarse depth is exact for cleared tiles
 	const FLOAT clearDepth = CSM_RENDERBUFFER_MAX_DEPTH;
 	if (depth == TRUE) {
-		__stosd(pBuffer->depth, *(PDWORD)&clearDepth, elemCount);
+		__stosd(pBuffer->hizMin, *(PDWORD)&clearDepth, blockCount);
+		__stosd(pBuffer->hizMax, *(PDWORD)&clearDepth, blockCount);
+		ZERO_BYTES(pBuffer->hizDirty, sizeof(BOOL) * blockCount);
 	}
 
-	_CSyncLeave(TRUE);
+	_CCallLeave(TRUE);
+}
+
+CSMCALL BOOL CRenderBufferGetColorFloat(CHandle handle, INT x, INT y, PCVect4F colorOut) {
+	_CCallEnter();
+
+	if (handle == NULL) {
+		_CCallLeaveErr(FALSE, "CRenderBufferGetColorFloat failed because handle was invalid");
+	}
+	if (colorOut == NULL) {
+		_CCallLeaveErr(FALSE, "CRenderBufferGetColorFloat failed because colorOut was NULL");
+	}
+
+	PCRenderBuffer pBuffer = handle;
+	if (_checkPosInRB(pBuffer, x, y) == FALSE) {
+		_CCallLeaveErr(FALSE, "CRenderBufferGetColorFloat failed because position was invalid");
+	}
+
+	// only float colors keep values outside of CColor range
+	if (_clearOwed(pBuffer, x, y, CSMINT_RB_CLEAR_COLOR))
+		*colorOut = CMakeVect4F(0.0f, 0.0f, 0.0f, 0.0f);
+	else if (pBuffer->colorFormat == CColorFormat_RGBA32F)
+		*colorOut = _findColorFloatPtr(pBuffer, x, y)[0];
+	else
+		*colorOut = CFragmentConvertColorToVect4(_readColor(pBuffer, x, y));
+
+	_CCallLeave(TRUE);
 }
 
 CSMCALL BOOL CRenderBufferUnsafeGetFragment(CHandle handle, INT x, INT y,
 	PCColor colorOut, PFLOAT depthOut) {
-	colorOut[0] = _findColorPtr(handle, x, y)[0];
-	depthOut[0] = _findDepthPtr(handle, x, y)[0];
+	colorOut[0] = _readColorOrClear(handle, x, y);
+	depthOut[0] = _readDepthOrClear(handle, x, y);
 
 	return TRUE;
 }
 
 CSMCALL BOOL CRenderBufferUnsafeSetFragment(CHandle handle, INT x, INT y,
 	CColor color, FLOAT depth) {
-	if (CRenderBufferUnsafeDepthTest(handle, x, y, depth) == FALSE) return FALSE;
+	PCRenderBuffer pBuffer = handle;
+	_resolveTile(pBuffer, _findHiZBlock(pBuffer, x, y), CSMINT_RB_CLEAR_COLOR | CSMINT_RB_CLEAR_DEPTH);
+
+	if (CInternalRenderBufferWriteDepth(handle, x, y, depth) == FALSE) return FALSE;
 
-	_findColorPtr(handle, x, y)[0] = color;
-	_findDepthPtr(handle, x, y)[0] = depth;
+	_writeColor(handle, x, y, color);
 
 	return TRUE;
 }
 
 CSMCALL BOOL CRenderBufferUnsafeDepthTest(CHandle handle, INT x, INT y, FLOAT newDepth) {
-	// do depth test
-	FLOAT oldDepth;
-	oldDepth = _findDepthPtr(handle, x, y)[0];
-	if (oldDepth - newDepth >= CSM_RENDERBUFFER_DEPTH_TEST_EPSILON) {
-		return FALSE;
+	PCRenderBuffer pBuffer = handle;
+	_resolveTile(pBuffer, _findHiZBlock(pBuffer, x, y), CSMINT_RB_CLEAR_DEPTH);
+
+	return _depthTest(pBuffer, x, y, newDepth);
+}
+
+// region of a render buffer copied to or from user bytes, split into row bands
+// note: rows of bytes are tightly packed, the first row is y unless vertically inverted
+typedef struct CIBytesCopy {
+	PCRenderBuffer		rb;
+	PBYTE				bytes;
+	CTextureBytesFormat format;
+	BOOL				verticalInversion;
+	INT					x, y, width, height;
+	PCColor				rowColors; // one row per worker, for export
+} CIBytesCopy, *PCIBytesCopy;
+
+static __forceinline INT _findCopyRowY(PCIBytesCopy copy, INT row) {
+	if (copy->verticalInversion)
+		return copy->y + (copy->height - row - 1);
+	return copy->y + row;
+}
+
+static void _importBandJob(PVOID param, UINT32 jobIndex, UINT32 workerIndex) {
+	PCIBytesCopy   copy = param;
+	PCRenderBuffer rb	= copy->rb;
+
+	SIZE_T rowBytes = (SIZE_T)copy->width * CInternalBytesFormatSize(copy->format);
+	INT startRow = jobIndex * CSMINT_CONVERT_BAND_ROWS;
+	INT endRow	 = min(copy->height, startRow + CSMINT_CONVERT_BAND_ROWS);
+
+	// note: the buffer is always linear BGRA8, so rows convert straight into the planes
+	// loaded pixels have depth 0, as if each were set with CRenderBufferSetFragment
+	const FLOAT loadedDepth = 0.0f;
+	for (INT row = startRow; row < endRow; row++) {
+		INT y = _findCopyRowY(copy, row);
+		CInternalConvertBytesToColors(_findColorPtr(rb, 0, y), copy->bytes + rowBytes * row,
+			copy->width, copy->format);
+		__stosd((PDWORD)_findDepthPtr(rb, 0, y), *(PDWORD)&loadedDepth, copy->width);
 	}
+}
 
-	return TRUE;
+static void _gatherColorRow(PCRenderBuffer b, INT x, INT y, INT count, PCColor dst) {
+	// one tile row at a time, which is contiguous in every layout
+	INT endX = x + count;
+	while (x < endX) {
+		INT segmentEnd = min(endX, (x | CSMINT_RB_TILE_MASK) + 1);
+		INT segment	   = segmentEnd - x;
+
+		if (_clearOwed(b, x, y, CSMINT_RB_CLEAR_COLOR))
+			ZERO_BYTES(dst, sizeof(CColor) * segment);
+		else if (b->colorFormat == CColorFormat_BGRA8)
+			COPY_BYTES(_findColorPtr(b, x, y), dst, sizeof(CColor) * segment);
+		else
+			for (INT i = 0; i < segment; i++) dst[i] = _readColor(b, x + i, y);
+
+		dst += segment;
+		x	 = segmentEnd;
+	}
+}
+
+static void _exportBandJob(PVOID param, UINT32 jobIndex, UINT32 workerIndex) {
+	PCIBytesCopy copy	   = param;
+	PCColor		 rowColors = copy->rowColors + (SIZE_T)workerIndex * copy->width;
+
+	SIZE_T rowBytes = (SIZE_T)copy->width * CInternalBytesFormatSize(copy->format);
+	INT startRow = jobIndex * CSMINT_CONVERT_BAND_ROWS;
+	INT endRow	 = min(copy->height, startRow + CSMINT_CONVERT_BAND_ROWS);
+
+	for (INT row = startRow; row < endRow; row++) {
+		_gatherColorRow(copy->rb, copy->x, _findCopyRowY(copy, row), copy->width, rowColors);
+		CInternalConvertColorsToBytes(copy->bytes + rowBytes * row, rowColors,
+			copy->width, copy->format);
+	}
+}
+
+static void _runCopyBands(PCIWorkerJobProc bandJob, PCIBytesCopy copy) {
+	UINT32 bandCount = (copy->height + CSMINT_CONVERT_BAND_ROWS - 1) / CSMINT_CONVERT_BAND_ROWS;
+
+	// a single band isn't worth waking the workers for
+	if (bandCount == 1)
+		bandJob(copy, 0, 0);
+	else
+		CInternalWorkerRun(bandJob, copy, bandCount);
 }
 
 CSMCALL BOOL CMakeRenderBufferFromBytes(PCHandle pHandle, INT width, INT height,
@@ -200,82 +571,201 @@ CSMCALL BOOL CMakeRenderBufferFromBytes(PCHandle pHandle, INT width, INT height,
 	}
 
 	// make render buffer
-	CMakeRenderBuffer(pHandle, width, height);
-	PBYTE  inBuffer = inBytes;
-	UINT32 baseIndex;			// baseindex for inBuffer pixel
-	UINT32 scanlineSizeBytes;	// scanline size
-	UINT32 yActual;				// y accounting for vertical inversion
-
-	// set all values based on inBytes
-	for (UINT32 x = 0; x < width; x++) {
-		for (UINT32 y = 0; y < height; y++) {
-
-			// color to send to "fragment"
-			CColor color = CMakeColor3(255, 0, 255);
-
-			// calculate proper Y position
-			if (verticalInversion)
-				yActual = height - y - 1;
-			else
-				yActual = y;
-
-			switch (byteFormat)
-			{
-			case CTextureBytesFormat_RGB:
-				scanlineSizeBytes = width * 3;
-				baseIndex = (scanlineSizeBytes * yActual) + (x * 3);
-				color.r = inBuffer[baseIndex + 0];
-				color.g = inBuffer[baseIndex + 1];
-				color.b = inBuffer[baseIndex + 2];
-
-				break;
-
-			case CTextureBytesFormat_BRG:
-				scanlineSizeBytes = width * 3;
-				baseIndex = (scanlineSizeBytes * yActual) + (x * 3);
-				color.r = inBuffer[baseIndex + 2];
-				color.g = inBuffer[baseIndex + 1];
-				color.b = inBuffer[baseIndex + 0];
-
-				break;
-
-			case CTextureBytesFormat_RGBA:
-				scanlineSizeBytes = width * 4;
-				baseIndex = (scanlineSizeBytes * yActual) + (x * 4);
-				color.r = inBuffer[baseIndex + 0];
-				color.g = inBuffer[baseIndex + 1];
-				color.b = inBuffer[baseIndex + 2];
-				color.a = inBuffer[baseIndex + 3];
-
-				break;
-
-			case CTextureBytesFormat_ARGB:
-				scanlineSizeBytes = width * 4;
-				baseIndex = (scanlineSizeBytes * yActual) + (x * 4);
-				color.r = inBuffer[baseIndex + 3];
-				color.g = inBuffer[baseIndex + 2];
-				color.b = inBuffer[baseIndex + 1];
-				color.a = inBuffer[baseIndex + 0];
-
-				break;
-
-			case CTextureBytesFormat_BRGA:
-				scanlineSizeBytes = width * 4;
-				baseIndex = (scanlineSizeBytes * yActual) + (x * 4);
-				color.r = inBuffer[baseIndex + 2];
-				color.g = inBuffer[baseIndex + 1];
-				color.b = inBuffer[baseIndex + 0];
-				color.a = inBuffer[baseIndex + 3];
-
-				break;
-
-			default:
-				break;
-			}
-
-			CRenderBufferSetFragment(*pHandle, x, y, color, 0);
-		}
+	if (CMakeRenderBuffer(pHandle, width, height) == FALSE) {
+		_CSyncLeave(FALSE);
 	}
+	PCRenderBuffer rb = *pHandle;
+
+	CIBytesCopy copy;
+	ZERO_BYTES(&copy, sizeof(copy));
+	copy.rb		= rb;
+	copy.bytes	= inBytes;
+	copy.format = byteFormat;
+	copy.verticalInversion = verticalInversion;
+	copy.width	= width;
+	copy.height = height;
+
+	// convert row bands without the global lock, nothing else can see the buffer yet
+	CInternalGlobalUnlock();
+	_runCopyBands(_importBandJob, &copy);
+	CInternalGlobalLock();
+
+	// every pixel was written, so no clear is owed and coarse depth is exact
+	const FLOAT loadedDepth = 0.0f;
+	INT blockCount = rb->hizWidth * rb->hizHeight;
+	ZERO_BYTES(rb->tileClear, sizeof(BYTE) * blockCount);
+	__stosd(rb->hizMin, *(PDWORD)&loadedDepth, blockCount);
+	__stosd(rb->hizMax, *(PDWORD)&loadedDepth, blockCount);
 
 	_CSyncLeave(TRUE);
 }
+
+CSMCALL BOOL CRenderBufferExportBytes(CHandle handle, INT x, INT y, INT width, INT height,
+	PVOID outBytes, CTextureBytesFormat byteFormat, BOOL verticalInversion) {
+	_CCallEnter();
+
+	if (handle == NULL) {
+		_CCallLeaveErr(FALSE, "CRenderBufferExportBytes failed because handle was invalid");
+	}
+	if (outBytes == NULL) {
+		_CCallLeaveErr(FALSE, "CRenderBufferExportBytes failed because outBytes was NULL");
+	}
+	if (byteFormat >= CTextureBytesFormat_Error) {
+		_CCallLeaveErr(FALSE, "CRenderBufferExportBytes failed because byteFormat was invalid");
+	}
+
+	PCRenderBuffer pBuffer = handle;
+	if (width < 1 || height < 1 || x < 0 || y < 0 ||
+		x + width > (INT)pBuffer->width || y + height > (INT)pBuffer->height) {
+		_CCallLeaveErr(FALSE, "CRenderBufferExportBytes failed because region was invalid");
+	}
+
+	CIBytesCopy copy;
+	copy.rb		= pBuffer;
+	copy.bytes	= outBytes;
+	copy.format = byteFormat;
+	copy.verticalInversion = verticalInversion;
+	copy.x		= x;
+	copy.y		= y;
+	copy.width	= width;
+	copy.height = height;
+
+	// note: reads never fill owed clears, so bands may share tiles
+	copy.rowColors = CInternalAllocUnzeroed(sizeof(CColor) * width * CInternalWorkerCount());
+	_runCopyBands(_exportBandJob, &copy);
+	CInternalFree(copy.rowColors);
+
+	_CCallLeave(TRUE);
+}
+
+FLOAT CInternalRenderBufferHiZMin(PCRenderBuffer rb, UINT32 blockX, UINT32 blockY) {
+	UINT32 block = blockX + (blockY * rb->hizWidth);
+	if (rb->hizDirty[block] == FALSE)
+		return rb->hizMin[block];
+
+	// refresh min from every pixel of block
+	INT startX = blockX * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	INT startY = blockY * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+	INT endX   = min((INT)rb->width,  startX + CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+	INT endY   = min((INT)rb->height, startY + CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+
+	FLOAT blockMin = rb->hizMax[block];
+	for (INT y = startY; y < endY; y++) {
+		if (rb->depthFormat == CDepthFormat_Unorm16) {
+			PUINT16 depthRow = _findDepth16Ptr(rb, startX, y);
+			for (INT x = 0; x < endX - startX; x++)
+				blockMin = min(blockMin, _decodeDepth16(depthRow[x]));
+			continue;
+		}
+
+		PFLOAT depthRow = _findDepthPtr(rb, startX, y);
+		for (INT x = 0; x < endX - startX; x++)
+			blockMin = min(blockMin, depthRow[x]);
+	}
+
+	rb->hizMin[block] = blockMin;
+	rb->hizDirty[block] = FALSE;
+	return blockMin;
+}
+
+BOOL  CInternalRenderBufferWriteDepth(PCRenderBuffer rb, INT x, INT y, FLOAT depth) {
+	UINT32 block = _findHiZBlock(rb, x, y);
+
+	// coarse depth holds decoded 16 bit depth so that it bounds what is stored
+	if (rb->depthFormat == CDepthFormat_Unorm16) {
+		PUINT16 pDepth16 = _findDepth16Ptr(rb, x, y);
+		UINT16	encoded	 = _encodeDepth16(depth);
+		if (encoded <= pDepth16[0]) return FALSE;
+
+		if (_decodeDepth16(pDepth16[0]) <= rb->hizMin[block]) rb->hizDirty[block] = TRUE;
+		rb->hizMax[block] = max(rb->hizMax[block], _decodeDepth16(encoded));
+
+		pDepth16[0] = encoded;
+		return TRUE;
+	}
+
+	if (_depthTest(rb, x, y, depth) == FALSE) return FALSE;
+
+	// depth only grows between clears, so the block min only needs
+	// refreshing when the pixel holding it is overwritten
+	PFLOAT pDepth = _findDepthPtr(rb, x, y);
+	if (pDepth[0] <= rb->hizMin[block]) rb->hizDirty[block] = TRUE;
+	rb->hizMax[block] = max(rb->hizMax[block], depth);
+
+	pDepth[0] = depth;
+
+	return TRUE;
+}
+
+CColor CInternalRenderBufferReadColor(PCRenderBuffer rb, INT x, INT y) {
+	return _readColorOrClear(rb, x, y);
+}
+
+void  CInternalRenderBufferWriteColor(PCRenderBuffer rb, INT x, INT y, CColor color) {
+	_writeColor(rb, x, y, color);
+}
+
+void  CInternalRenderBufferBlendColor(PCRenderBuffer rb, INT x, INT y, CColor color) {
+	// float colors are blended in place, keeping full precision
+	if (rb->colorFormat == CColorFormat_RGBA32F) {
+		CInternalRenderBufferWriteColorFloat(rb, x, y, CFragmentConvertColorToVect4(color));
+		return;
+	}
+
+	_writeColor(rb, x, y, CFragmentBlendColor(_readColor(rb, x, y), color));
+}
+
+void  CInternalRenderBufferWriteColorFloat(PCRenderBuffer rb, INT x, INT y, CVect4F color) {
+	if (rb->colorFormat != CColorFormat_RGBA32F) {
+		CColor converted = CFragmentConvertVect4ToColor(color);
+		if (converted.a == 255) _writeColor(rb, x, y, converted);
+		else CInternalRenderBufferBlendColor(rb, x, y, converted);
+		return;
+	}
+
+	PCVect4F pColor = _findColorFloatPtr(rb, x, y);
+	if (color.w >= 255.0f) {
+		pColor[0] = color;
+		return;
+	}
+
+	// same blend as CFragmentBlendColor, without clamping or rounding
+	FLOAT alpha = color.w * 0.003921568627f; // div by 255
+	pColor->x = color.x * alpha + (1.0f - alpha) * pColor->x;
+	pColor->y = color.y * alpha + (1.0f - alpha) * pColor->y;
+	pColor->z = color.z * alpha + (1.0f - alpha) * pColor->z;
+	pColor->w = 255.0f;
+}
+
+PCColor CInternalRenderBufferLinearColor(PCRenderBuffer rb) {
+	// fill color of tiles that were never drawn to
+	for (UINT32 tileID = 0; tileID < rb->hizWidth * rb->hizHeight; tileID++)
+		_resolveTile(rb, tileID, CSMINT_RB_CLEAR_COLOR);
+
+	if (rb->layout == CRenderBufferLayout_Linear && rb->colorFormat == CColorFormat_BGRA8)
+		return rb->color;
+
+	// untile and convert into present copy, kept for the next present
+	if (rb->presentColor == NULL)
+		rb->presentColor = CInternalAllocUnzeroed(sizeof(CColor) * rb->width * rb->height);
+
+	for (UINT32 y = 0; y < rb->height; y++) {
+		PCColor dstRow = rb->presentColor + ((rb->height - y - 1) * rb->width);
+		if (rb->colorFormat != CColorFormat_BGRA8) {
+			for (UINT32 x = 0; x < rb->width; x++)
+				dstRow[x] = _readColor(rb, x, y);
+			continue;
+		}
+
+		for (UINT32 x = 0; x < rb->width; x += CSM_RENDERBUFFER_HIZ_BLOCK_SIZE) {
+			UINT32 count = min(CSM_RENDERBUFFER_HIZ_BLOCK_SIZE, rb->width - x);
+			COPY_BYTES(_findColorPtr(rb, x, y), dstRow + x, sizeof(CColor) * count);
+		}
+	}
+
+	return rb->presentColor;
+}
+
+void  CInternalRenderBufferResolveTile(PCRenderBuffer rb, UINT32 tileID) {
+	_resolveTile(rb, tileID, CSMINT_RB_CLEAR_COLOR | CSMINT_RB_CLEAR_DEPTH);
+}
@@ -7,13 +7,70 @@
 
 #define CSM_RENDERBUFFER_MAX_DEPTH				(FLOAT)(-100)
 #define CSM_RENDERBUFFER_DEPTH_TEST_EPSILON		(FLOAT)(-0.001)
+#define CSM_RENDERBUFFER_HIZ_BLOCK_SIZE			0x08
+#define CSM_RENDERBUFFER_TILE_SHIFT				0x03 // tiles are one coarse depth block
+#define CSM_RENDERBUFFER_PLANE_ALIGNMENT		0x40
 
 #include "csm.h"
 
+#if (1 << CSM_RENDERBUFFER_TILE_SHIFT) != CSM_RENDERBUFFER_HIZ_BLOCK_SIZE
+#error "render buffer tiles must match coarse depth blocks"
+#endif
+
+// memory layout of the color and depth planes
+typedef enum CRenderBufferLayout {
+	CRenderBufferLayout_Linear, // rows of width pixels, bottom row first
+	CRenderBufferLayout_Tiled,	// tiles row by row, each tile holds its rows contiguously
+	CRenderBufferLayout_Error
+} CRenderBufferLayout, *PCRenderBufferLayout;
+
+// storage of the depth plane, depths are always read and written as floats
+typedef enum CDepthFormat {
+	CDepthFormat_Float32,
+	CDepthFormat_Unorm16,	// linear between CSM_RENDERBUFFER_MAX_DEPTH and 0, half the memory
+	CDepthFormat_Error
+} CDepthFormat, *PCDepthFormat;
+
+// storage of the color plane, colors are read and written as CColor unless noted
+typedef enum CColorFormat {
+	CColorFormat_BGRA8,		// CColor
+	CColorFormat_RGB565,	// no alpha, reads back opaque
+	CColorFormat_RGBA32F,	// same scale as CColor but unclamped, blended without rounding
+	CColorFormat_Error
+} CColorFormat, *PCColorFormat;
+
+typedef struct CRenderBufferDesc {
+	INT					width, height;
+	CRenderBufferLayout layout;
+	CDepthFormat		depthFormat;
+	CColorFormat		colorFormat;
+	BOOL				dither;	// ordered dithering on writes to CColorFormat_RGB565
+} CRenderBufferDesc, *PCRenderBufferDesc;
+
 typedef struct CRenderBuffer {
 	UINT32	width, height;
-	PCColor	color;
-	PFLOAT	depth;
+	CRenderBufferLayout layout;
+	CDepthFormat depthFormat;
+	CColorFormat colorFormat;
+	BOOL	dither;
+	SIZE_T	planePixels;	// pixels per plane, tiled planes are padded to whole tiles
+	PVOID	color;			// both planes start on a CSM_RENDERBUFFER_PLANE_ALIGNMENT boundary
+	PVOID	depth;			// one value of depthFormat per pixel
+	PVOID	colorMemory;	// allocations the planes were aligned within
+	PVOID	depthMemory;
+	PCColor	presentColor;	// linear CColor copy of the color plane, made on present when needed
+
+	// coarse depth per block of CSM_RENDERBUFFER_HIZ_BLOCK_SIZE pixels
+	// note: hizMin is never above the real min, it is refreshed lazily when dirty
+	UINT32	hizWidth, hizHeight;
+	PFLOAT	hizMin;
+	PFLOAT	hizMax;
+	PBOOL	hizDirty;
+
+	// clears still owed to each tile, one per coarse depth block
+	// note: clearing only marks tiles, a tile is filled when first drawn to
+	// and the rest when presented, reads of a marked tile return the clear value
+	PBYTE	tileClear;
 } CRenderBuffer, *PCRenderBuffer;
 
 typedef enum CTextureBytesFormat {
@@ -26,6 +83,10 @@ typedef enum CTextureBytesFormat {
 } CTextureBytesFormat, *PCTextureBytesFormat;
 
 CSMCALL BOOL CMakeRenderBuffer(PCHandle pHandle, INT width, INT height);
+CSMCALL BOOL CMakeRenderBufferEx(PCHandle pHandle, PCRenderBufferDesc desc);
+CSMCALL CRenderBufferLayout CRenderBufferGetLayout(CHandle handle);
+CSMCALL CDepthFormat CRenderBufferGetDepthFormat(CHandle handle);
+CSMCALL CColorFormat CRenderBufferGetColorFormat(CHandle handle);
 CSMCALL BOOL CDestroyRenderBuffer(PCHandle pHandle);
 
 CSMCALL BOOL CRenderBufferGetFragment(CHandle handle, INT x, INT y,
@@ -34,6 +95,7 @@ CSMCALL BOOL CRenderBufferSetFragment(CHandle handle, INT x, INT y,
 	CColor color, FLOAT depth);
 CSMCALL BOOL CRenderBufferDepthTest(CHandle handle, INT x, INT y, FLOAT newDepth);
 CSMCALL BOOL CRenderBufferClear(CHandle handle, BOOL color, BOOL depth);
+CSMCALL BOOL CRenderBufferGetColorFloat(CHandle handle, INT x, INT y, PCVect4F colorOut); // unclamped
 
 CSMCALL BOOL CRenderBufferUnsafeGetFragment(CHandle handle, INT x, INT y,
 	PCColor colorOut, PFLOAT depthOut);
@@ -44,4 +106,9 @@ CSMCALL BOOL CRenderBufferUnsafeDepthTest(CHandle handle, INT x, INT y, FLOAT ne
 CSMCALL BOOL CMakeRenderBufferFromBytes(PCHandle pHandle, INT width, INT height, 
 	PVOID inBytes, CTextureBytesFormat byteFormat, BOOL verticalInversion);
 
+// copies a region of color into tightly packed rows, the first row is y unless vertically inverted
+// note: both this and CMakeRenderBufferFromBytes convert row bands on the worker threads
+CSMCALL BOOL CRenderBufferExportBytes(CHandle handle, INT x, INT y, INT width, INT height,
+	PVOID outBytes, CTextureBytesFormat byteFormat, BOOL verticalInversion);
+
 #endif
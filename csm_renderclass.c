@@ -31,6 +31,8 @@ CSMCALL CHandle CMakeMaterial(PCHAR name,
 }
 
 CSMCALL BOOL	CDestroyMaterial(PCHandle pMatHandle) {
+	_CSyncEnter();
+
 	if (pMatHandle == NULL) {
 		_CSyncLeaveErr(FALSE, "CDestroyMaterial failed because pMatHandle was NULL");
 	}
@@ -47,6 +49,21 @@ CSMCALL BOOL	CDestroyMaterial(PCHandle pMatHandle) {
 	_CSyncLeave(TRUE);
 }
 
+CSMCALL BOOL	CMaterialSetVertexBatchShader(CHandle material,
+	PCFVertexBatchShaderProc vertexBatchShader) {
+	_CSyncEnter();
+
+	if (material == NULL) {
+		_CSyncLeaveErr(FALSE, "CMaterialSetVertexBatchShader failed because material was invalid");
+	}
+
+	// NULL is acceptable and reverts to the per-vertex shader
+	PCMaterial mat = material;
+	mat->vertexBatchShader = vertexBatchShader;
+
+	_CSyncLeave(TRUE);
+}
+
 CSMCALL CHandle CMakeRenderClass(PCHAR name, CHandle mesh, CHandle material) {
 	_CSyncEnter();
 
@@ -427,3 +444,13 @@ CSMCALL UINT32  CRenderClassGetStaticDataBufferID(CHandle rClass, PCHAR name) {
 	_CSyncLeaveErr(FALSE,
 		"CRenderClassGetStaticDataBufferID failed because name could not be found");
 }
+
+PCVertexDataBuffer CInternalRenderClassGetVertexDataBuffer(PCRenderClass rClass, UINT32 ID) {
+	if (ID >= CSM_CLASS_MAX_VERTEX_DATA) return NULL;
+	return rClass->vertexBuffers[ID];
+}
+
+PCStaticDataBuffer CInternalRenderClassGetStaticDataBuffer(PCRenderClass rClass, UINT32 ID) {
+	if (ID >= CSM_CLASS_MAX_STATIC_DATA) return NULL;
+	return rClass->staticBuffers[ID];
+}
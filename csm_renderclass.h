@@ -12,6 +12,8 @@
 #define CSM_CLASS_MAX_MATERIALS			0x08
 #define CSM_BAD_ID						~(0x0)
 
+// note: the vertex shader is called once per vertex per instance, shared vertices
+// reuse the result. triangleID is that of the first triangle to reference the vertex
 typedef CVect3F (*PCFVertexShaderProc) (
 	CHandle vertContext,
 	UINT32  vertexID,
@@ -20,6 +22,13 @@ typedef CVect3F (*PCFVertexShaderProc) (
 	CVect3F vertexPosition
 	);
 
+// optional structure-of-arrays vertex shader, see CVertexBatch in <csm_vertex.h>
+// note: when set on a material it is used instead of the per-vertex shader
+typedef void (*PCFVertexBatchShaderProc) (
+	CHandle vertContext,
+	struct CVertexBatch* batch
+	);
+
 typedef struct CFragPos {
 	INT   x;
 	INT	  y;
@@ -36,8 +45,9 @@ typedef BOOL (*PCFFragmentShaderProc) (
 
 typedef struct CMaterial {
 	PCHAR name;
-	PCFVertexShaderProc   vertexShader;
-	PCFFragmentShaderProc fragmentShader;
+	PCFVertexShaderProc		 vertexShader;
+	PCFVertexBatchShaderProc vertexBatchShader;
+	PCFFragmentShaderProc	 fragmentShader;
 } CMaterial, * PCMaterial;
 
 typedef struct CRenderClass {
@@ -54,6 +64,8 @@ CSMCALL CHandle CMakeMaterial(PCHAR name,
 	PCFVertexShaderProc vertexShader,
 	PCFFragmentShaderProc fragmentShader);
 CSMCALL BOOL	CDestroyMaterial(PCHandle pMatHandle);
+CSMCALL BOOL	CMaterialSetVertexBatchShader(CHandle material,
+	PCFVertexBatchShaderProc vertexBatchShader);
 
 CSMCALL CHandle CMakeRenderClass(PCHAR name, CHandle mesh, CHandle material);
 CSMCALL BOOL	CDestroyRenderClass(PCHandle pClass);
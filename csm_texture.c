@@ -0,0 +1,534 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csm_texture.c>
+
+#include "csmint.h"
+#include "csm_texture.h"
+#include "csm_fragment.h"
+#include <math.h>
+#include <immintrin.h>
+
+#define CSMINT_TEXTURE_TILE_SIZE	(1 << CSM_TEXTURE_TILE_SHIFT)
+#define CSMINT_TEXTURE_TILE_MASK	(CSMINT_TEXTURE_TILE_SIZE - 1)
+#define CSMINT_TEXTURE_ALIGNMENT	0x40
+
+static __forceinline PCColor _findTexelPtr(PCTextureLevel level, UINT32 x, UINT32 y) {
+	return level->texels +
+		((((y >> CSM_TEXTURE_TILE_SHIFT) * level->tilesX + (x >> CSM_TEXTURE_TILE_SHIFT))
+			<< (CSM_TEXTURE_TILE_SHIFT * 2)) +
+		((y & CSMINT_TEXTURE_TILE_MASK) << CSM_TEXTURE_TILE_SHIFT) + (x & CSMINT_TEXTURE_TILE_MASK));
+}
+
+static PCTexture _makeTexture(UINT32 width, UINT32 height) {
+	PCTexture texture = CInternalAlloc(sizeof(CTexture));
+	texture->width	= width;
+	texture->height = height;
+
+	// size every level down to 1x1
+	SIZE_T texelCount = 0;
+	UINT32 levelWidth = width, levelHeight = height;
+	while (TRUE) {
+		PCTextureLevel level = texture->levels + texture->levelCount;
+		level->width  = levelWidth;
+		level->height = levelHeight;
+		level->tilesX = (levelWidth + CSMINT_TEXTURE_TILE_MASK) >> CSM_TEXTURE_TILE_SHIFT;
+		texture->levelCount++;
+
+		// note: whole tiles are a multiple of the alignment, so every level stays aligned
+		UINT32 tilesY = (levelHeight + CSMINT_TEXTURE_TILE_MASK) >> CSM_TEXTURE_TILE_SHIFT;
+		texelCount += (SIZE_T)level->tilesX * tilesY << (CSM_TEXTURE_TILE_SHIFT * 2);
+
+		if (levelWidth == 1 && levelHeight == 1) break;
+		levelWidth	= max(1, levelWidth  >> 1);
+		levelHeight = max(1, levelHeight >> 1);
+	}
+
+	// padding texels of edge tiles are never sampled, but are zeroed anyway
+	texture->memory = CInternalAlloc(sizeof(CColor) * texelCount + CSMINT_TEXTURE_ALIGNMENT);
+	PCColor texels	= (PCColor)(((ULONG_PTR)texture->memory + CSMINT_TEXTURE_ALIGNMENT - 1) &
+		~(ULONG_PTR)(CSMINT_TEXTURE_ALIGNMENT - 1));
+
+	for (UINT32 levelID = 0; levelID < texture->levelCount; levelID++) {
+		PCTextureLevel level = texture->levels + levelID;
+		UINT32 tilesY = (level->height + CSMINT_TEXTURE_TILE_MASK) >> CSM_TEXTURE_TILE_SHIFT;
+		level->texels = texels;
+		texels += (SIZE_T)level->tilesX * tilesY << (CSM_TEXTURE_TILE_SHIFT * 2);
+	}
+
+	return texture;
+}
+
+// halves a linear level with a 2x2 box filter
+// note: odd sides drop their last row or column, sides of 1 texel repeat it
+static void _downsampleLevel(const CColor* src, UINT32 srcWidth, UINT32 srcHeight,
+	PCColor dst, UINT32 dstWidth, UINT32 dstHeight) {
+	const __m128i zero	= _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(2);
+
+	for (UINT32 y = 0; y < dstHeight; y++) {
+		const CColor* row0 = src + (SIZE_T)min(y * 2,	 srcHeight - 1) * srcWidth;
+		const CColor* row1 = src + (SIZE_T)min(y * 2 + 1, srcHeight - 1) * srcWidth;
+		PCColor dstRow = dst + (SIZE_T)y * dstWidth;
+
+		// 4 texels out of 8 texels from each row, channels widened to 16 bits
+		UINT32 x = 0;
+		for (; x + 4 <= dstWidth; x += 4) {
+			__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 2));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(row0 + x * 2 + 4));
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(row1 + x * 2));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 2 + 4));
+
+			// sum rows, each register holds 2 columns
+			__m128i aLo = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a1, zero));
+			__m128i aHi = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a1, zero));
+			__m128i bLo = _mm_add_epi16(_mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(b1, zero));
+			__m128i bHi = _mm_add_epi16(_mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(b1, zero));
+
+			// sum neighbouring columns, then average with rounding
+			__m128i sumA = _mm_add_epi16(_mm_unpacklo_epi64(aLo, aHi), _mm_unpackhi_epi64(aLo, aHi));
+			__m128i sumB = _mm_add_epi16(_mm_unpacklo_epi64(bLo, bHi), _mm_unpackhi_epi64(bLo, bHi));
+			sumA = _mm_srli_epi16(_mm_add_epi16(sumA, round), 2);
+			sumB = _mm_srli_epi16(_mm_add_epi16(sumB, round), 2);
+
+			_mm_storeu_si128((__m128i*)(dstRow + x), _mm_packus_epi16(sumA, sumB));
+		}
+
+		// filter leftover texels one by one
+		for (; x < dstWidth; x++) {
+			UINT32 x0 = min(x * 2,	   srcWidth - 1);
+			UINT32 x1 = min(x * 2 + 1, srcWidth - 1);
+			const BYTE* texels[4] = {
+				(const BYTE*)(row0 + x0), (const BYTE*)(row0 + x1),
+				(const BYTE*)(row1 + x0), (const BYTE*)(row1 + x1)
+			};
+
+			PBYTE pDst = (PBYTE)(dstRow + x);
+			for (UINT32 channel = 0; channel < 4; channel++)
+				pDst[channel] = (texels[0][channel] + texels[1][channel] +
+					texels[2][channel] + texels[3][channel] + 2) >> 2;
+		}
+	}
+}
+
+static void _tileLevel(PCTextureLevel level, const CColor* linear) {
+	for (UINT32 y = 0; y < level->height; y++) {
+		const CColor* srcRow = linear + (SIZE_T)y * level->width;
+		for (UINT32 x = 0; x < level->width; x += CSMINT_TEXTURE_TILE_SIZE) {
+			UINT32 count = min(CSMINT_TEXTURE_TILE_SIZE, level->width - x);
+			COPY_BYTES(srcRow + x, _findTexelPtr(level, x, y), sizeof(CColor) * count);
+		}
+	}
+}
+
+// makes every level from a linear level 0, rows bottom first
+static void _buildLevels(PCTexture texture, const CColor* linearBase) {
+	// levels are filtered linearly and tiled once done
+	SIZE_T scratchCount = 0;
+	for (UINT32 levelID = 1; levelID < texture->levelCount; levelID++)
+		scratchCount += (SIZE_T)texture->levels[levelID].width * texture->levels[levelID].height;
+	PCColor scratch = NULL;
+	if (scratchCount != 0)
+		scratch = CInternalAllocUnzeroed(sizeof(CColor) * scratchCount);
+
+	const CColor* srcLinear = linearBase;
+	PCColor		  dstLinear = scratch;
+	_tileLevel(texture->levels, linearBase);
+
+	for (UINT32 levelID = 1; levelID < texture->levelCount; levelID++) {
+		PCTextureLevel src = texture->levels + levelID - 1;
+		PCTextureLevel dst = texture->levels + levelID;
+
+		_downsampleLevel(srcLinear, src->width, src->height, dstLinear, dst->width, dst->height);
+		_tileLevel(dst, dstLinear);
+
+		srcLinear  = dstLinear;
+		dstLinear += (SIZE_T)dst->width * dst->height;
+	}
+
+	if (scratch != NULL)
+		CInternalFree(scratch);
+}
+
+CSMCALL BOOL CMakeTextureFromBytes(PCHandle pHandle, INT width, INT height,
+	PVOID inBytes, CTextureBytesFormat byteFormat, BOOL verticalInversion) {
+	_CSyncEnter();
+
+	if (pHandle == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromBytes failed because pHandle was NULL");
+	}
+	if (width < 1 || height < 1) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromBytes failed because dimensions were invalid");
+	}
+	if (inBytes == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromBytes failed because inBytes was NULL");
+	}
+	if (byteFormat >= CTextureBytesFormat_Error) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromBytes failed because byteFormat was invalid");
+	}
+
+	// convert to a linear level 0
+	PCColor linearBase = CInternalAllocUnzeroed(sizeof(CColor) * width * height);
+	SIZE_T	rowBytes   = (SIZE_T)width * CInternalBytesFormatSize(byteFormat);
+	for (INT row = 0; row < height; row++) {
+		INT y = verticalInversion ? (height - row - 1) : row;
+		CInternalConvertBytesToColors(linearBase + (SIZE_T)y * width,
+			(PBYTE)inBytes + rowBytes * row, width, byteFormat);
+	}
+
+	PCTexture texture = _makeTexture(width, height);
+	_buildLevels(texture, linearBase);
+	CInternalFree(linearBase);
+
+	*pHandle = texture;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL BOOL CMakeTextureFromRenderBuffer(PCHandle pHandle, CHandle renderBuffer) {
+	_CSyncEnter();
+
+	if (pHandle == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromRenderBuffer failed because pHandle was NULL");
+	}
+	if (renderBuffer == NULL) {
+		_CSyncLeaveErr(FALSE, "CMakeTextureFromRenderBuffer failed because renderBuffer was invalid");
+	}
+
+	PCRenderBuffer rb = renderBuffer;
+
+	// BRGA is the same layout as CColor, rows come out bottom first
+	// note: the export uses the workers, so it runs without the global lock
+	PCColor linearBase = CInternalAllocUnzeroed(sizeof(CColor) * rb->width * rb->height);
+	CInternalGlobalUnlock();
+	CRenderBufferExportBytes(rb, 0, 0, rb->width, rb->height, linearBase,
+		CTextureBytesFormat_BRGA, FALSE);
+	CInternalGlobalLock();
+
+	PCTexture texture = _makeTexture(rb->width, rb->height);
+	_buildLevels(texture, linearBase);
+	CInternalFree(linearBase);
+
+	*pHandle = texture;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL BOOL CDestroyTexture(PCHandle pHandle) {
+	_CSyncEnter();
+
+	if (pHandle == NULL) {
+		_CSyncLeaveErr(FALSE, "CDestroyTexture failed because pHandle was NULL");
+	}
+
+	PCTexture texture = *pHandle;
+	if (texture == NULL) {
+		_CSyncLeaveErr(FALSE, "CDestroyTexture failed because pHandle was invalid");
+	}
+
+	CInternalFree(texture->memory);
+	CInternalFree(texture);
+
+	*pHandle = NULL;
+
+	_CSyncLeave(TRUE);
+}
+
+CSMCALL UINT32 CTextureGetLevelCount(CHandle texture) {
+	_CSyncEnter();
+
+	if (texture == NULL) {
+		_CSyncLeaveErr(0, "CTextureGetLevelCount failed because texture was invalid");
+	}
+
+	PCTexture pTexture = texture;
+
+	_CSyncLeave(pTexture->levelCount);
+}
+
+// brings a texel coordinate into the level, FALSE when it samples the transparent border
+static __forceinline BOOL _wrapTexelCoord(PINT coord, INT size, CSampleType sampleType) {
+	switch (sampleType)
+	{
+	case CSampleType_Clamp:
+		return (*coord >= 0 && *coord < size);
+
+	case CSampleType_ClampToEdge:
+		*coord = max(0, min(*coord, size - 1));
+		return TRUE;
+
+	default:
+		*coord %= size;
+		if (*coord < 0) *coord += size;
+		return TRUE;
+	}
+}
+
+static __forceinline __m128 _loadTexel(PCTextureLevel level, INT x, INT y, CSampleType sampleType) {
+	if (_wrapTexelCoord(&x, level->width,  sampleType) == FALSE ||
+		_wrapTexelCoord(&y, level->height, sampleType) == FALSE) return _mm_setzero_ps();
+
+	// widen channels to floats, keeping CColor's b g r a order
+	const __m128i zero = _mm_setzero_si128();
+	__m128i texel = _mm_cvtsi32_si128(*(PINT)_findTexelPtr(level, x, y));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(texel, zero), zero));
+}
+
+static __forceinline CColor _storeTexel(__m128 color) {
+	__m128i packed = _mm_cvtps_epi32(color);
+	packed = _mm_packs_epi32(packed, packed);
+	packed = _mm_packus_epi16(packed, packed);
+
+	INT bits = _mm_cvtsi128_si32(packed);
+	return *(PCColor)&bits;
+}
+
+static __forceinline __m128 _lerp(__m128 from, __m128 to, FLOAT factor) {
+	return _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), _mm_set1_ps(factor)));
+}
+
+static __forceinline CColor _sampleNearest(PCTextureLevel level, CVect2F uv, CSampleType sampleType) {
+	INT x = (INT)floorf(uv.x * level->width);
+	INT y = (INT)floorf(uv.y * level->height);
+	if (_wrapTexelCoord(&x, level->width,  sampleType) == FALSE ||
+		_wrapTexelCoord(&y, level->height, sampleType) == FALSE) return CMakeColor4(0, 0, 0, 0);
+
+	return _findTexelPtr(level, x, y)[0];
+}
+
+static __forceinline __m128 _sampleBilinear(PCTextureLevel level, CVect2F uv, CSampleType sampleType) {
+	// texel centers are at half texel offsets
+	FLOAT texelX = uv.x * level->width  - 0.5f;
+	FLOAT texelY = uv.y * level->height - 0.5f;
+	FLOAT floorX = floorf(texelX);
+	FLOAT floorY = floorf(texelY);
+	INT x = (INT)floorX;
+	INT y = (INT)floorY;
+
+	// note: the 4 texels usually share one tile, so one cache line
+	__m128 bottom = _lerp(_loadTexel(level, x, y,	  sampleType),
+		_loadTexel(level, x + 1, y,		sampleType), texelX - floorX);
+	__m128 top	  = _lerp(_loadTexel(level, x, y + 1, sampleType),
+		_loadTexel(level, x + 1, y + 1, sampleType), texelX - floorX);
+	return _lerp(bottom, top, texelY - floorY);
+}
+
+FLOAT  CInternalTextureFindLod(PCTexture texture, CVect2F uvDX, CVect2F uvDY) {
+	// footprint of one pixel in level 0 texels, the longer side picks the level
+	FLOAT dxU = uvDX.x * texture->width;
+	FLOAT dxV = uvDX.y * texture->height;
+	FLOAT dyU = uvDY.x * texture->width;
+	FLOAT dyV = uvDY.y * texture->height;
+	FLOAT footprint = max(dxU * dxU + dxV * dxV, dyU * dyU + dyV * dyV);
+
+	// magnified samples use level 0, squared footprint halves the log
+	if (footprint <= 1.0f) return 0.0f;
+	return min(0.5f * log2f(footprint), (FLOAT)(texture->levelCount - 1));
+}
+
+CColor CInternalTextureSample(PCTexture texture, CVect2F uv, FLOAT lod, CSampleType sampleType,
+	CTextureFilter filter) {
+	// keep coordinates small enough to convert to texel integers
+	if (sampleType == CSampleType_Repeat) {
+		uv.x -= floorf(uv.x);
+		uv.y -= floorf(uv.y);
+	}
+	else {
+		uv.x = max(-1.0f, min(uv.x, 2.0f));
+		uv.y = max(-1.0f, min(uv.y, 2.0f));
+	}
+
+	if (filter == CTextureFilter_Trilinear) {
+		UINT32 levelID	 = (UINT32)lod;
+		FLOAT  levelFrac = lod - (FLOAT)levelID;
+
+		__m128 color = _sampleBilinear(texture->levels + levelID, uv, sampleType);
+		if (levelFrac > 0.0f && levelID + 1 < texture->levelCount)
+			color = _lerp(color, _sampleBilinear(texture->levels + levelID + 1, uv, sampleType), levelFrac);
+		return _storeTexel(color);
+	}
+
+	// other filters use the nearest level
+	UINT32 levelID = min((UINT32)(lod + 0.5f), texture->levelCount - 1);
+	if (filter == CTextureFilter_Bilinear)
+		return _storeTexel(_sampleBilinear(texture->levels + levelID, uv, sampleType));
+	return _sampleNearest(texture->levels + levelID, uv, sampleType);
+}
+
+// 4 lane versions of the above, one sample per lane
+// note: every step matches the single sample path, so both give the same colors
+
+static __forceinline __m128 _floor4(__m128 value) {
+	// truncate, then step down where truncation rounded up
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+	return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, value), _mm_set1_ps(1.0f)));
+}
+
+static __forceinline __m128i _mullo4(__m128i a, __m128i b) {
+	// SSE2 has no 32 bit low multiply, so multiply even and odd lanes apart
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd	 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// wraps integral texel coordinates, returns the lanes that don't sample the border
+// note: coordinates are at most one level size outside of the level
+static __forceinline __m128 _wrapTexelCoord4(__m128* coord, UINT32 size, CSampleType sampleType) {
+	__m128 sizeF  = _mm_set1_ps((FLOAT)size);
+	__m128 lastF  = _mm_set1_ps((FLOAT)(size - 1));
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	switch (sampleType)
+	{
+	case CSampleType_Clamp:
+		inside = _mm_and_ps(_mm_cmpge_ps(*coord, _mm_setzero_ps()), _mm_cmplt_ps(*coord, sizeF));
+		*coord = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(*coord, lastF)); // keeps border lanes addressable
+		break;
+
+	case CSampleType_ClampToEdge:
+		*coord = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(*coord, lastF));
+		break;
+
+	default:
+		*coord = _mm_add_ps(*coord, _mm_and_ps(_mm_cmplt_ps(*coord, _mm_setzero_ps()), sizeF));
+		*coord = _mm_sub_ps(*coord, _mm_and_ps(_mm_cmpge_ps(*coord, sizeF), sizeF));
+		break;
+	}
+
+	return inside;
+}
+
+static __forceinline __m128i _fetchTexels4(PCTextureLevel level, __m128 x, __m128 y, __m128 inside) {
+	__m128i texelX = _mm_cvttps_epi32(x);
+	__m128i texelY = _mm_cvttps_epi32(y);
+
+	// same tiled index as _findTexelPtr
+	__m128i tileMask = _mm_set1_epi32(CSMINT_TEXTURE_TILE_MASK);
+	__m128i tileID	 = _mm_add_epi32(
+		_mullo4(_mm_srli_epi32(texelY, CSM_TEXTURE_TILE_SHIFT), _mm_set1_epi32(level->tilesX)),
+		_mm_srli_epi32(texelX, CSM_TEXTURE_TILE_SHIFT));
+	__m128i index	 = _mm_add_epi32(_mm_slli_epi32(tileID, CSM_TEXTURE_TILE_SHIFT * 2),
+		_mm_add_epi32(_mm_slli_epi32(_mm_and_si128(texelY, tileMask), CSM_TEXTURE_TILE_SHIFT),
+			_mm_and_si128(texelX, tileMask)));
+
+	// note: SSE2 has no gather, lanes are loaded one by one
+	INT indices[4];
+	_mm_storeu_si128((__m128i*)indices, index);
+	const INT* texels = (const INT*)level->texels;
+	__m128i gathered = _mm_setr_epi32(texels[indices[0]], texels[indices[1]],
+		texels[indices[2]], texels[indices[3]]);
+
+	return _mm_and_si128(gathered, _mm_castps_si128(inside));
+}
+
+static __forceinline void _splitChannels4(__m128i texels, __m128 channels[4]) {
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	channels[0] = _mm_cvtepi32_ps(_mm_and_si128(texels, byteMask));
+	channels[1] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8),	byteMask));
+	channels[2] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), byteMask));
+	channels[3] = _mm_cvtepi32_ps(_mm_srli_epi32(texels, 24));
+}
+
+static __forceinline __m128i _joinChannels4(const __m128 channels[4]) {
+	// note: blends of bytes never leave byte range, so no saturation is needed
+	__m128i joined = _mm_cvtps_epi32(channels[0]);
+	joined = _mm_or_si128(joined, _mm_slli_epi32(_mm_cvtps_epi32(channels[1]), 8));
+	joined = _mm_or_si128(joined, _mm_slli_epi32(_mm_cvtps_epi32(channels[2]), 16));
+	joined = _mm_or_si128(joined, _mm_slli_epi32(_mm_cvtps_epi32(channels[3]), 24));
+	return joined;
+}
+
+static __forceinline __m128 _lerp4(__m128 from, __m128 to, __m128 factor) {
+	return _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), factor));
+}
+
+static __forceinline __m128i _sampleNearest4(PCTextureLevel level, __m128 u, __m128 v, CSampleType sampleType) {
+	__m128 x = _floor4(_mm_mul_ps(u, _mm_set1_ps((FLOAT)level->width)));
+	__m128 y = _floor4(_mm_mul_ps(v, _mm_set1_ps((FLOAT)level->height)));
+	__m128 inside = _mm_and_ps(_wrapTexelCoord4(&x, level->width, sampleType),
+		_wrapTexelCoord4(&y, level->height, sampleType));
+
+	return _fetchTexels4(level, x, y, inside);
+}
+
+static __forceinline void _sampleBilinear4(PCTextureLevel level, __m128 u, __m128 v, CSampleType sampleType,
+	__m128 channels[4]) {
+	// texel centers are at half texel offsets
+	__m128 half	  = _mm_set1_ps(0.5f);
+	__m128 texelX = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((FLOAT)level->width)),  half);
+	__m128 texelY = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((FLOAT)level->height)), half);
+	__m128 x0	  = _floor4(texelX);
+	__m128 y0	  = _floor4(texelY);
+	__m128 fracX  = _mm_sub_ps(texelX, x0);
+	__m128 fracY  = _mm_sub_ps(texelY, y0);
+
+	// neighbours are found before wrapping, as they are wrapped on their own
+	__m128 x1 = _mm_add_ps(x0, _mm_set1_ps(1.0f));
+	__m128 y1 = _mm_add_ps(y0, _mm_set1_ps(1.0f));
+	__m128 insideX0 = _wrapTexelCoord4(&x0, level->width,  sampleType);
+	__m128 insideX1 = _wrapTexelCoord4(&x1, level->width,  sampleType);
+	__m128 insideY0 = _wrapTexelCoord4(&y0, level->height, sampleType);
+	__m128 insideY1 = _wrapTexelCoord4(&y1, level->height, sampleType);
+
+	__m128 corners[4][4];
+	_splitChannels4(_fetchTexels4(level, x0, y0, _mm_and_ps(insideX0, insideY0)), corners[0]);
+	_splitChannels4(_fetchTexels4(level, x1, y0, _mm_and_ps(insideX1, insideY0)), corners[1]);
+	_splitChannels4(_fetchTexels4(level, x0, y1, _mm_and_ps(insideX0, insideY1)), corners[2]);
+	_splitChannels4(_fetchTexels4(level, x1, y1, _mm_and_ps(insideX1, insideY1)), corners[3]);
+
+	for (UINT32 channel = 0; channel < 4; channel++) {
+		__m128 bottom = _lerp4(corners[0][channel], corners[1][channel], fracX);
+		__m128 top	  = _lerp4(corners[2][channel], corners[3][channel], fracX);
+		channels[channel] = _lerp4(bottom, top, fracY);
+	}
+}
+
+void   CInternalTextureSample4(PCTexture texture, const CVect2F* uvs, FLOAT lod, CSampleType sampleType,
+	CTextureFilter filter, PCColor colorsOut) {
+	// split interleaved uvs into lanes
+	__m128 uv01 = _mm_loadu_ps((const FLOAT*)uvs);
+	__m128 uv23 = _mm_loadu_ps((const FLOAT*)(uvs + 2));
+	__m128 u	= _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 v	= _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+
+	// keep coordinates small enough to convert to texel integers
+	// note: floats this large are already whole, so limiting them keeps repeat exact
+	if (sampleType == CSampleType_Repeat) {
+		u = _mm_max_ps(_mm_set1_ps(-8388608.0f), _mm_min_ps(u, _mm_set1_ps(8388608.0f)));
+		v = _mm_max_ps(_mm_set1_ps(-8388608.0f), _mm_min_ps(v, _mm_set1_ps(8388608.0f)));
+		u = _mm_sub_ps(u, _floor4(u));
+		v = _mm_sub_ps(v, _floor4(v));
+	}
+	else {
+		u = _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(u, _mm_set1_ps(2.0f)));
+		v = _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(v, _mm_set1_ps(2.0f)));
+	}
+
+	if (filter == CTextureFilter_Trilinear) {
+		UINT32 levelID	 = (UINT32)lod;
+		FLOAT  levelFrac = lod - (FLOAT)levelID;
+
+		__m128 channels[4];
+		_sampleBilinear4(texture->levels + levelID, u, v, sampleType, channels);
+		if (levelFrac > 0.0f && levelID + 1 < texture->levelCount) {
+			__m128 nextChannels[4];
+			_sampleBilinear4(texture->levels + levelID + 1, u, v, sampleType, nextChannels);
+			for (UINT32 channel = 0; channel < 4; channel++)
+				channels[channel] = _lerp4(channels[channel], nextChannels[channel], _mm_set1_ps(levelFrac));
+		}
+
+		_mm_storeu_si128((__m128i*)colorsOut, _joinChannels4(channels));
+		return;
+	}
+
+	// other filters use the nearest level
+	UINT32 levelID = min((UINT32)(lod + 0.5f), texture->levelCount - 1);
+	if (filter == CTextureFilter_Bilinear) {
+		__m128 channels[4];
+		_sampleBilinear4(texture->levels + levelID, u, v, sampleType, channels);
+		_mm_storeu_si128((__m128i*)colorsOut, _joinChannels4(channels));
+		return;
+	}
+
+	_mm_storeu_si128((__m128i*)colorsOut, _sampleNearest4(texture->levels + levelID, u, v, sampleType));
+}
@@ -0,0 +1,44 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csm_texture.h>
+
+#ifndef _CSM_TEXTURE_INCLUDE_
+#define _CSM_TEXTURE_INCLUDE_
+
+#include "csm_renderbuffer.h"
+
+#define CSM_TEXTURE_MAX_LEVELS		0x20
+#define CSM_TEXTURE_TILE_SHIFT		0x02 // 4x4 texels, one cache line
+
+typedef enum CTextureFilter {
+	CTextureFilter_Nearest,		// nearest texel of the nearest level
+	CTextureFilter_Bilinear,	// 4 texels of the nearest level
+	CTextureFilter_Trilinear,	// bilinear in the two nearest levels, blended by level
+	CTextureFilter_Error
+} CTextureFilter, *PCTextureFilter;
+
+// one level of the mip chain
+typedef struct CTextureLevel {
+	UINT32	width, height;
+	UINT32	tilesX;		// tiles per tile row
+	PCColor	texels;		// tiles row by row, each tile holds its rows contiguously
+} CTextureLevel, *PCTextureLevel;
+
+// read only color image with a box filtered mip chain, texel (0, 0) is at uv (0, 0)
+// note: unlike a render buffer there is no depth plane, and levels are never drawn to
+typedef struct CTexture {
+	UINT32			width, height;
+	UINT32			levelCount;	// down to 1x1, each level halves both sides rounding down
+	CTextureLevel	levels[CSM_TEXTURE_MAX_LEVELS];
+	PVOID			memory;		// every level, in one allocation
+} CTexture, *PCTexture;
+
+// same byte conventions as CMakeRenderBufferFromBytes
+CSMCALL BOOL CMakeTextureFromBytes(PCHandle pHandle, INT width, INT height,
+	PVOID inBytes, CTextureBytesFormat byteFormat, BOOL verticalInversion);
+CSMCALL BOOL CMakeTextureFromRenderBuffer(PCHandle pHandle, CHandle renderBuffer);
+CSMCALL BOOL CDestroyTexture(PCHandle pHandle);
+
+CSMCALL UINT32 CTextureGetLevelCount(CHandle texture);
+
+#endif
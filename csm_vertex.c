@@ -21,7 +21,7 @@ CSMCALL BOOL	CVertexGetDrawInput(CHandle vertContext, UINT32 drawInputID, PVOID
 
 	PCIPTriContext triContext = vertContext;
 
-	PCDrawInput drawInput = triContext->drawContext->inputs + drawInputID;
+	PCDrawInput drawInput = triContext->drawInputs + drawInputID;
 	COPY_BYTES(drawInput->pData, outBuffer, drawInput->sizeBytes);
 
 	return TRUE;
@@ -38,7 +38,7 @@ CSMCALL PVOID	CVertexUnsafeGetDrawInputDirect(CHandle vertContext, UINT32 drawIn
 	}
 
 	PCIPTriContext triContext = vertContext;
-	return triContext->drawContext->inputs[drawInputID].pData;
+	return triContext->drawInputs[drawInputID].pData;
 }
 
 CSMCALL SIZE_T	CVertexGetDrawInputSizeBytes(CHandle vertContext, UINT32 drawInputID) {
@@ -53,7 +53,7 @@ CSMCALL SIZE_T	CVertexGetDrawInputSizeBytes(CHandle vertContext, UINT32 drawInpu
 
 	PCIPTriContext triContext = vertContext;
 
-	PCDrawInput drawInput = triContext->drawContext->inputs + drawInputID;
+	PCDrawInput drawInput = triContext->drawInputs + drawInputID;
 
 	return drawInput->sizeBytes;
 }
@@ -70,14 +70,21 @@ CSMCALL BOOL CVertexGetClassVertexData(CHandle vertContext, UINT32 ID, PFLOAT ou
 
 	PCIPTriContext triContext = vertContext;
 
-	PCVertexDataBuffer vdb = 
-		CRenderClassGetVertexDataBuffer(triContext->rClass, ID);
-	if (vdb == NULL) {
+	if (triContext->vertOutputs == NULL) {
+		CInternalSetLastError("CVertexGetClassVertexData failed because it is unavailable to batched vertex shaders");
+		return FALSE;
+	}
+
+	if (ID >= CSM_CLASS_MAX_VERTEX_DATA || triContext->vertexStreams[ID].data == NULL) {
 		CInternalSetLastError("CVertexGetClassVertexData failed because ID was invalid");
 		return FALSE;
 	}
 
-	CVertexDataBufferUnsafeGetElement(vdb, triContext->vertexID, outBuffer);
+	// streams cover every mesh vertex, so the vertex indexes them directly
+	PCVertexStream stream = triContext->vertexStreams + ID;
+	const FLOAT* element = stream->data + (stream->stride * triContext->vertexID);
+	for (UINT32 comp = 0; comp < stream->components; comp++)
+		outBuffer[comp] = element[comp];
 
 	return TRUE;
 }
@@ -90,14 +97,34 @@ CSMCALL UINT32	CVertexGetClassVertexDataComponentCount(CHandle vertContext, UINT
 
 	PCIPTriContext triContext = vertContext;
 
-	PCVertexDataBuffer vdb =
-		CRenderClassGetVertexDataBuffer(triContext->rClass, ID);
-	if (vdb == NULL) {
+	if (ID >= CSM_CLASS_MAX_VERTEX_DATA || triContext->vertexStreams[ID].data == NULL) {
 		CInternalSetLastError("CVertexGetClassVertexDataComponentCount failed because ID was invalid");
 		return FALSE;
 	}
 
-	return vdb->elementComponents;
+	return triContext->vertexStreams[ID].components;
+}
+
+CSMCALL BOOL	CVertexGetClassVertexStream(CHandle vertContext, UINT32 ID, PCVertexStream outStream) {
+	if (vertContext == NULL) {
+		CInternalSetLastError("CVertexGetClassVertexStream failed because vertContext was invalid");
+		return FALSE;
+	}
+	if (outStream == NULL) {
+		CInternalSetLastError("CVertexGetClassVertexStream failed because outStream was NULL");
+		return FALSE;
+	}
+
+	PCIPTriContext triContext = vertContext;
+
+	if (ID >= CSM_CLASS_MAX_VERTEX_DATA || triContext->vertexStreams[ID].data == NULL) {
+		CInternalSetLastError("CVertexGetClassVertexStream failed because ID was invalid");
+		return FALSE;
+	}
+
+	*outStream = triContext->vertexStreams[ID];
+
+	return TRUE;
 }
 
 CSMCALL BOOL CVertexGetClassStaticData(CHandle vertContext, UINT32 ID, PFLOAT outBuffer) {
@@ -112,19 +139,34 @@ CSMCALL BOOL CVertexGetClassStaticData(CHandle vertContext, UINT32 ID, PFLOAT ou
 
 	PCIPTriContext triContext = vertContext;
 
-	PCStaticDataBuffer sdb = CRenderClassGetStaticDataBuffer(triContext->rClass, ID);
+	PCStaticDataBuffer sdb = CInternalRenderClassGetStaticDataBuffer(triContext->rClass, ID);
 	if (sdb == NULL) {
 		CInternalSetLastError("CVertexGetClassStaticData failed because ID was invalid");
 		return FALSE;
 	}
 
-	PVOID data = CStaticDataBufferMap(sdb);
-	COPY_BYTES(data, outBuffer, sdb->sizeBytes);
-	CStaticDataBufferUnmap(sdb);
+	// copy to outbuffer from the version pinned by the draw
+	COPY_BYTES(triContext->staticData[ID]->data, outBuffer, sdb->sizeBytes);
 
 	return TRUE;
 }
 
+CSMCALL PVOID	CVertexGetClassStaticDataDirect(CHandle vertContext, UINT32 ID) {
+	if (vertContext == NULL) {
+		CInternalSetLastError("CVertexGetClassStaticDataDirect failed because vertContext was invalid");
+		return NULL;
+	}
+
+	PCIPTriContext triContext = vertContext;
+
+	if (CInternalRenderClassGetStaticDataBuffer(triContext->rClass, ID) == NULL) {
+		CInternalSetLastError("CVertexGetClassStaticDataDirect failed because ID was invalid");
+		return NULL;
+	}
+
+	return triContext->staticData[ID]->data;
+}
+
 CSMCALL SIZE_T	CVertexGetClassStaticDataSizeBytes(CHandle vertContext, UINT32 ID) {
 	if (vertContext == NULL) {
 		CInternalSetLastError("CVertexGetClassStaticDataSizeBytes failed because vertContext was invalid");
@@ -133,7 +175,7 @@ CSMCALL SIZE_T	CVertexGetClassStaticDataSizeBytes(CHandle vertContext, UINT32 ID
 
 	PCIPTriContext triContext = vertContext;
 
-	PCStaticDataBuffer sdb = CRenderClassGetStaticDataBuffer(triContext->rClass, ID);
+	PCStaticDataBuffer sdb = CInternalRenderClassGetStaticDataBuffer(triContext->rClass, ID);
 	if (sdb == NULL) {
 		CInternalSetLastError("CVertexGetClassStaticDataSizeBytes failed because ID was invalid");
 		return FALSE;
@@ -163,9 +205,14 @@ CSMCALL BOOL CVertexSetVertexOutput(CHandle vertContext, UINT32 outputID,
 
 	PCIPTriContext context = vertContext;
 
+	if (context->vertOutputs == NULL) {
+		CInternalSetLastError("CVertexSetVertexOutput failed because it is unavailable to batched vertex shaders");
+		return FALSE;
+	}
+
 	// get vertex output ptr
 	PCIPVertOutput pOut = 
-		context->screenTriAndData->vertOutputs[context->triVertexID].outputs + outputID;
+		context->vertOutputs->outputs + outputID;
 	
 	// set value
 	pOut->componentCount = components;
@@ -191,25 +238,25 @@ CSMCALL BOOL CVertexSetVertexOutputFromClassVertexData(CHandle vertContext,
 
 	PCIPTriContext context = vertContext;
 
+	if (context->vertOutputs == NULL) {
+		CInternalSetLastError("CVertexSetVertexOutputFromClassVertexData failed because it is unavailable to batched vertex shaders");
+		return FALSE;
+	}
 
 	// get vertex data from class
-	FLOAT outBuff[CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS];
-	
-	UINT32 components = CVertexGetClassVertexDataComponentCount(context, classVertID);
-
-	// if DNE
-	if (components == 0) {
+	if (context->vertexStreams[classVertID].data == NULL) {
 		CInternalSetLastError("CVertexSetVertexOutputFromClassVertexData failed because vertex data could not be found");
 		return FALSE;
 	}
 
-	CVertexGetClassVertexData(context, classVertID, outBuff);
-
 	// set output value
+	PCVertexStream stream = context->vertexStreams + classVertID;
+	const FLOAT* element = stream->data + (stream->stride * context->vertexID);
 	PCIPVertOutput pOut =
-		context->screenTriAndData->vertOutputs[context->triVertexID].outputs + outputID;
-	pOut->componentCount = components;
-	COPY_BYTES(outBuff, pOut->valueBuffer, sizeof(FLOAT) * components);
+		context->vertOutputs->outputs + outputID;
+	pOut->componentCount = stream->components;
+	for (UINT32 comp = 0; comp < stream->components; comp++)
+		pOut->valueBuffer[comp] = element[comp];
 
 	return TRUE;
 }
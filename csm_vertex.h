@@ -9,6 +9,30 @@
 #include "csm_draw.h"
 
 #define CSM_MAX_VERTEX_OUTPUTS				0x10
+#define CSM_VERTEX_BATCH_SIZE				0x40
+
+// raw view of a class vertex data buffer, valid for one draw
+// note: element of vertex i starts at data + (i * stride), every mesh vertex has one
+typedef struct CVertexStream {
+	const FLOAT* data;
+	UINT32		 stride;	 // floats between elements
+	UINT32		 components;
+} CVertexStream, *PCVertexStream;
+
+// vertices given to a batched vertex shader as structure-of-arrays
+// note: every array holds count values, index i of each array belongs to vertexIDs[i]
+// note: arrays are 32 byte aligned and padded to CSM_VERTEX_BATCH_SIZE
+typedef struct CVertexBatch {
+	UINT32	count;
+	UINT32	instanceID;
+	PUINT32	vertexIDs;
+	PFLOAT	inPositions[3]; // x, y, z
+	UINT32	inVertexDataComponents[CSM_CLASS_MAX_VERTEX_DATA]; // 0 when unbound
+	PFLOAT	inVertexData[CSM_CLASS_MAX_VERTEX_DATA][CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS];
+	PFLOAT	outPositions[3]; // x, y, z
+	UINT32	outputComponents[CSM_MAX_VERTEX_OUTPUTS]; // set by shader, 0 when unwritten
+	PFLOAT	outputs[CSM_MAX_VERTEX_OUTPUTS][CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS];
+} CVertexBatch, *PCVertexBatch;
 
 CSMCALL BOOL	CVertexGetDrawInput(CHandle vertContext, UINT32 drawInputID, PVOID outBuffer);
 CSMCALL PVOID	CVertexUnsafeGetDrawInputDirect(CHandle vertContext, UINT32 drawInputID);
@@ -16,9 +40,12 @@ CSMCALL SIZE_T	CVertexGetDrawInputSizeBytes(CHandle vertContext, UINT32 drawInpu
 
 CSMCALL BOOL	CVertexGetClassVertexData(CHandle vertContext, UINT32 ID, PFLOAT outBuffer);
 CSMCALL UINT32	CVertexGetClassVertexDataComponentCount(CHandle vertContext, UINT32 ID);
+CSMCALL BOOL	CVertexGetClassVertexStream(CHandle vertContext, UINT32 ID, PCVertexStream outStream);
 
 CSMCALL BOOL	CVertexGetClassStaticData(CHandle vertContext, UINT32 ID, PFLOAT outBuffer);
 CSMCALL SIZE_T	CVertexGetClassStaticDataSizeBytes(CHandle vertContext, UINT32 ID);
+// note: read only, stays valid and unchanged until the draw ends even if the buffer is remapped
+CSMCALL PVOID	CVertexGetClassStaticDataDirect(CHandle vertContext, UINT32 ID);
 
 CSMCALL BOOL	CVertexSetVertexOutput(CHandle vertContext, UINT32 outputID,
 	PFLOAT inBuffer, UINT32 components);
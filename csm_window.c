@@ -56,7 +56,7 @@ static LRESULT CALLBACK _csmWndProc(HWND win, UINT msg, WPARAM wP, LPARAM lP) {
 		rbBitmap.bmWidthBytes = pBuffer->width * sizeof(CColor);
 		rbBitmap.bmPlanes = 1;
 		rbBitmap.bmBitsPixel = 32;
-		rbBitmap.bmBits = pBuffer->color;
+		rbBitmap.bmBits = CInternalRenderBufferLinearColor(pBuffer);
 
 		// make hBitMap
 		HBITMAP hBitMap = CreateBitmapIndirect(&rbBitmap);
@@ -4,23 +4,38 @@
 
 #include "csmint.h"
 
+PCIThreadState CInternalGetThreadState(void) {
+	PCIThreadState state = TlsGetValue(_csmint.threadStateTls);
+	if (state != NULL) return state;
+
+	// make state on first call from this thread
+	// note: not counted as an allocation, released with the heap
+	state = HeapAlloc(_csmint.heap, HEAP_ZERO_MEMORY, sizeof(CIThreadState));
+	TlsSetValue(_csmint.threadStateTls, state);
+	return state;
+}
+
 void CInternalPushFuncNameStack(PCHAR funcname) {
+	PCIThreadState state = CInternalGetThreadState();
+
 	// check stack over/underflow
-	if (_csmint.funcNameStackPtr >= CSMINT_FUNCNAMESTACK_SIZE)
+	if (state->funcNameStackPtr >= CSMINT_FUNCNAMESTACK_SIZE)
 		CInternalErrorPopup("Faulty FuncNameStack State");
 
-	_csmint.funcNameStack[_csmint.funcNameStackPtr] = funcname;
-	_csmint.funcNameStackPtr++;
+	state->funcNameStack[state->funcNameStackPtr] = funcname;
+	state->funcNameStackPtr++;
 }
 
 void CInternalPopFuncNameStack(void) {
+	PCIThreadState state = CInternalGetThreadState();
+
 	// check stack over/underflow
-	if (_csmint.funcNameStackPtr >= CSMINT_FUNCNAMESTACK_SIZE)
+	if (state->funcNameStackPtr >= CSMINT_FUNCNAMESTACK_SIZE)
 		CInternalErrorPopup("Faulty FuncNameStack State");
 
-	_csmint.funcNameStack[_csmint.funcNameStackPtr] = NULL;
+	state->funcNameStack[state->funcNameStackPtr] = NULL;
 
-	_csmint.funcNameStackPtr--;
+	state->funcNameStackPtr--;
 }
 
 void CInternalGlobalLock(void) {
@@ -10,44 +10,67 @@
 
 #define CSMINT_FUNCNAMESTACK_SIZE	0x80
 
+// call context and error state, kept per thread so threads never share diagnostics
+typedef struct CIThreadState {
+	PCHAR	lastError;
+	PCHAR	funcNameStack[CSMINT_FUNCNAMESTACK_SIZE];
+	UINT32	funcNameStackPtr;
+	BOOL	inWorkerJob;	// running a job of a worker pool run
+	UINT32	workerIndex;	// of that run, only valid while inWorkerJob
+} CIThreadState, *PCIThreadState;
+
 typedef struct Caesium {
 	BOOL   init;
 	HANDLE heap;
 
-	PCHAR lastError;
+	DWORD threadStateTls;
 	BOOL  logErrors;
 
 	BOOL threadsafe;
-	UINT32 allocateCount;
 	CRITICAL_SECTION lock; // thread sync object
 
+	DWORD				 allocTls;	 // thread's allocation cache
+	struct CIAllocDepot* allocDepot;
+
 	PCWindow windows[CSM_MAX_WINDOWS];
 
-	PCHAR	funcNameStack[CSMINT_FUNCNAMESTACK_SIZE];
-	UINT32	funcNameStackPtr;
+	struct CIWorkerPool* workerPool; // lazily created by first tiled draw
+	CRITICAL_SECTION	 workerLock;
+
+	struct CIRenderThread* renderThread; // lazily created by first async draw
 
 	LARGE_INTEGER perfCounterHzMs;
 } Caesium, *PCaesium;
 Caesium _csmint;
 
+PCIThreadState CInternalGetThreadState(void);
 void CInternalPushFuncNameStack(PCHAR funcname);
 void CInternalPopFuncNameStack(void);
 
 void CInternalGlobalLock(void);
 void CInternalGlobalUnlock(void);
 
-#define _CSyncEnter( )	CInternalPushFuncNameStack(__func__); \
-						CInternalGlobalLock()
+#define _CSyncEnter( )	CInternalGlobalLock(); \
+						CInternalPushFuncNameStack(__func__)
 
 #define _CSyncLeave(x)	CInternalPopFuncNameStack();		 \
 						CInternalGlobalUnlock(); \
 						return x
 
+// for calls that only touch objects owned by the calling thread, see <csm_draw.h>
+#define _CCallEnter( )	CInternalPushFuncNameStack(__func__)
+
+#define _CCallLeave(x)	CInternalPopFuncNameStack(); \
+						return x
+
 #define ZERO_BYTES(ptr, count) __stosb(ptr, ZERO, count) 
 #define COPY_BYTES(src, dest, count) __movsb(dest, src, count)
 
 #include "csmint_memory.h"
 #include "csmint_error.h"
+#include "csmint_workers.h"
+#include "csmint_renderthread.h"
 #include "csmint_pipeline.h"
+#include "csmint_convert.h"
 
 #endif
@@ -0,0 +1,171 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_convert.c>
+
+#include "csmint_convert.h"
+#include <immintrin.h>
+
+// byte offset of each CColor channel within one user pixel, in b g r a order
+// note: -1 marks a channel the format doesn't store
+typedef struct CIBytesLayout {
+	UINT32	size;
+	INT		offsets[4];
+} CIBytesLayout, *PCIBytesLayout;
+
+static const CIBytesLayout _layouts[CTextureBytesFormat_Error] = {
+	{ 3, { 2, 1, 0, -1 } },	// RGB
+	{ 3, { 0, 1, 2, -1 } },	// BRG, stored as b g r
+	{ 4, { 2, 1, 0,  3 } },	// RGBA
+	{ 4, { 1, 2, 3,  0 } },	// ARGB, stored as a b g r
+	{ 4, { 0, 1, 2,  3 } }	// BRGA, same as CColor
+};
+
+static BOOL _cpuHasSSSE3(void) {
+	INT info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+}
+
+static BOOL _useSSSE3(void) {
+	// note: racing first calls all store the same value
+	static volatile LONG useSSSE3 = -1;
+
+	if (useSSSE3 < 0)
+		useSSSE3 = _cpuHasSSSE3() ? 1 : 0;
+
+	return useSSSE3 != 0;
+}
+
+static __forceinline __m128i _load4Pixels(const BYTE* src, UINT32 size) {
+	if (size == 4) return _mm_loadu_si128((const __m128i*)src);
+
+	// load exactly 12 bytes, never past the last pixel
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src),
+		_mm_cvtsi32_si128(*(const INT*)(src + 8)));
+}
+
+static __forceinline void _store4Pixels(PBYTE dst, __m128i pixels, UINT32 size) {
+	if (size == 4) {
+		_mm_storeu_si128((__m128i*)dst, pixels);
+		return;
+	}
+
+	_mm_storel_epi64((__m128i*)dst, pixels);
+	*(PINT)(dst + 8) = _mm_cvtsi128_si32(_mm_srli_si128(pixels, 8));
+}
+
+static void _bytesToColorsSSSE3(PCColor dst, const BYTE* src, UINT32 count, const CIBytesLayout* layout) {
+	// each lane picks its channel from the user bytes, missing channels are zeroed then filled
+	BYTE shuffle[16];
+	for (UINT32 lane = 0; lane < 16; lane++) {
+		INT offset = layout->offsets[lane & 3];
+		shuffle[lane] = (offset < 0) ? 0x80 : (BYTE)((lane >> 2) * layout->size + offset);
+	}
+	__m128i shuffleMask = _mm_loadu_si128((const __m128i*)shuffle);
+	__m128i alphaFill	= _mm_set1_epi32((layout->offsets[3] < 0) ? 0xFF000000 : 0);
+
+	UINT32 pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		__m128i pixels = _load4Pixels(src + pixel * layout->size, layout->size);
+		pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffleMask), alphaFill);
+		_mm_storeu_si128((__m128i*)(dst + pixel), pixels);
+	}
+
+	// convert leftover pixels one by one
+	for (; pixel < count; pixel++) {
+		const BYTE* pSrc  = src + pixel * layout->size;
+		PBYTE		pDst  = (PBYTE)(dst + pixel);
+		for (UINT32 channel = 0; channel < 4; channel++) {
+			INT offset = layout->offsets[channel];
+			pDst[channel] = (offset < 0) ? 0xFF : pSrc[offset];
+		}
+	}
+}
+
+static void _colorsToBytesSSSE3(PBYTE dst, const CColor* src, UINT32 count, const CIBytesLayout* layout) {
+	// each output byte picks its channel from the colors, unused lanes are zeroed
+	BYTE shuffle[16];
+	for (UINT32 lane = 0; lane < 16; lane++) shuffle[lane] = 0x80;
+	for (UINT32 pixel = 0; pixel < 4; pixel++) {
+		for (UINT32 channel = 0; channel < 4; channel++) {
+			INT offset = layout->offsets[channel];
+			if (offset >= 0) shuffle[pixel * layout->size + offset] = (BYTE)(pixel * 4 + channel);
+		}
+	}
+	__m128i shuffleMask = _mm_loadu_si128((const __m128i*)shuffle);
+
+	UINT32 pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		__m128i colors = _mm_loadu_si128((const __m128i*)(src + pixel));
+		_store4Pixels(dst + pixel * layout->size, _mm_shuffle_epi8(colors, shuffleMask), layout->size);
+	}
+
+	// convert leftover pixels one by one
+	for (; pixel < count; pixel++) {
+		const BYTE* pSrc = (const BYTE*)(src + pixel);
+		PBYTE		pDst = dst + pixel * layout->size;
+		for (UINT32 channel = 0; channel < 4; channel++) {
+			INT offset = layout->offsets[channel];
+			if (offset >= 0) pDst[offset] = pSrc[channel];
+		}
+	}
+}
+
+static void _bytesToColorsScalar(PCColor dst, const BYTE* src, UINT32 count, const CIBytesLayout* layout) {
+	INT offsetB = layout->offsets[0];
+	INT offsetG = layout->offsets[1];
+	INT offsetR = layout->offsets[2];
+	INT offsetA = layout->offsets[3];
+
+	for (UINT32 pixel = 0; pixel < count; pixel++) {
+		const BYTE* pSrc = src + pixel * layout->size;
+		dst[pixel].b = pSrc[offsetB];
+		dst[pixel].g = pSrc[offsetG];
+		dst[pixel].r = pSrc[offsetR];
+		dst[pixel].a = (offsetA < 0) ? 0xFF : pSrc[offsetA];
+	}
+}
+
+static void _colorsToBytesScalar(PBYTE dst, const CColor* src, UINT32 count, const CIBytesLayout* layout) {
+	INT offsetB = layout->offsets[0];
+	INT offsetG = layout->offsets[1];
+	INT offsetR = layout->offsets[2];
+	INT offsetA = layout->offsets[3];
+
+	for (UINT32 pixel = 0; pixel < count; pixel++) {
+		PBYTE pDst = dst + pixel * layout->size;
+		pDst[offsetB] = src[pixel].b;
+		pDst[offsetG] = src[pixel].g;
+		pDst[offsetR] = src[pixel].r;
+		if (offsetA >= 0) pDst[offsetA] = src[pixel].a;
+	}
+}
+
+void   CInternalConvertBytesToColors(PCColor dst, const BYTE* src, UINT32 count, CTextureBytesFormat format) {
+	const CIBytesLayout* layout = _layouts + format;
+
+	// same layout as CColor is a plain copy
+	if (format == CTextureBytesFormat_BRGA) {
+		COPY_BYTES(src, dst, sizeof(CColor) * count);
+		return;
+	}
+
+	if (_useSSSE3()) _bytesToColorsSSSE3(dst, src, count, layout);
+	else _bytesToColorsScalar(dst, src, count, layout);
+}
+
+void   CInternalConvertColorsToBytes(PBYTE dst, const CColor* src, UINT32 count, CTextureBytesFormat format) {
+	const CIBytesLayout* layout = _layouts + format;
+
+	if (format == CTextureBytesFormat_BRGA) {
+		COPY_BYTES(src, dst, sizeof(CColor) * count);
+		return;
+	}
+
+	if (_useSSSE3()) _colorsToBytesSSSE3(dst, src, count, layout);
+	else _colorsToBytesScalar(dst, src, count, layout);
+}
+
+UINT32 CInternalBytesFormatSize(CTextureBytesFormat format) {
+	return _layouts[format].size;
+}
@@ -0,0 +1,19 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_convert.h>
+
+#ifndef _CSMINT_CONVERT_INCLUDE_
+#define _CSMINT_CONVERT_INCLUDE_
+
+#include "csmint.h"
+
+#define CSMINT_CONVERT_BAND_ROWS	0x40 // rows per worker job when converting whole images
+
+// converts one row of pixels between user bytes and CColor
+// note: 3 byte formats drop alpha on export and read back as opaque
+// note: SSSE3 shuffles when available and scalar otherwise, chosen once by cpu features
+void   CInternalConvertBytesToColors(PCColor dst, const BYTE* src, UINT32 count, CTextureBytesFormat format);
+void   CInternalConvertColorsToBytes(PBYTE dst, const CColor* src, UINT32 count, CTextureBytesFormat format);
+UINT32 CInternalBytesFormatSize(CTextureBytesFormat format);
+
+#endif
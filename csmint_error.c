@@ -10,35 +10,32 @@ void  CInternalErrorPopup(PCHAR message) {
 }
 
 void  CInternalSetLastError(PCHAR lastError) {
-	_CSyncEnter();
+	// note: errors are per thread, so no global lock is needed
+	PCIThreadState state = CInternalGetThreadState();
 	
 	// free last memory if applicable
-	if (_csmint.lastError != NULL)
-		CInternalFree(_csmint.lastError);
+	if (state->lastError != NULL)
+		CInternalFree(state->lastError);
 
 	// get string size and realloc lastError to len + 1 (for NULL character)
 	const SIZE_T strSize = strlen(lastError);
-	_csmint.lastError = CInternalAlloc(strSize + 1);
+	state->lastError = CInternalAlloc(strSize + 1);
 
 	// copy string
-	COPY_BYTES(lastError, _csmint.lastError, strSize);
+	COPY_BYTES(lastError, state->lastError, strSize);
 
 	// log if needed
 	if (_csmint.logErrors != NULL) {
 		fprintf(stderr, "Current Caesium Error: %s\n", lastError);
 		fprintf(stderr, "Caesium callstack: \n");
-		for (UINT32 stackID = 0; stackID <= _csmint.funcNameStackPtr; stackID++) {
-			fprintf(stderr, "CALLSTACK [%02d]: %s\n", stackID, _csmint.funcNameStack[stackID]);
+		for (UINT32 stackID = 0; stackID <= state->funcNameStackPtr; stackID++) {
+			fprintf(stderr, "CALLSTACK [%02d]: %s\n", stackID, state->funcNameStack[stackID]);
 		}
 	}
-		
-
-	_CSyncLeave();
 }
 
 void CInternalGetLastError(PCHAR errBuffer, SIZE_T maxSize) {
-	_CSyncEnter();
-	if (_csmint.lastError != NULL)
-		strcpy_s(errBuffer, maxSize, _csmint.lastError);
-	_CSyncLeave();
+	PCIThreadState state = CInternalGetThreadState();
+	if (state->lastError != NULL)
+		strcpy_s(errBuffer, maxSize, state->lastError);
 }
@@ -14,4 +14,7 @@ void  CInternalGetLastError(PCHAR errBuffer, SIZE_T maxSize);
 #define _CSyncLeaveErr(x, err)	CInternalSetLastError(err); \
 								_CSyncLeave(x)
 
+#define _CCallLeaveErr(x, err)	CInternalSetLastError(err); \
+								_CCallLeave(x)
+
 #endif
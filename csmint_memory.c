@@ -2,19 +2,196 @@
 // 2023
 // <csmint_memory.c>
 
+#include "csmint.h"
 #include "csmint_memory.h"
 
+void CInternalInitAllocator(void) {
+	_csmint.allocTls   = TlsAlloc();
+	_csmint.allocDepot = HeapAlloc(_csmint.heap, HEAP_ZERO_MEMORY, sizeof(CIAllocDepot));
+	InitializeCriticalSection(&_csmint.allocDepot->lock);
+}
+
+LONG CInternalAllocCount(void) {
+	PCIAllocDepot depot = _csmint.allocDepot;
+
+	LONG allocateCount = 0;
+	EnterCriticalSection(&depot->lock);
+	for (PCIThreadCache cache = depot->caches; cache != NULL; cache = cache->next)
+		allocateCount += cache->allocateCount;
+	LeaveCriticalSection(&depot->lock);
+
+	return allocateCount;
+}
+
+static PCIThreadCache _getThreadCache(void) {
+	PCIThreadCache cache = TlsGetValue(_csmint.allocTls);
+	if (cache != NULL) return cache;
+
+	// make cache on first use by this thread
+	// note: caches outlive their threads, they are released with the heap
+	PCIAllocDepot depot = _csmint.allocDepot;
+	cache = HeapAlloc(_csmint.heap, HEAP_ZERO_MEMORY, sizeof(CIThreadCache));
+	EnterCriticalSection(&depot->lock);
+	cache->next	  = depot->caches;
+	depot->caches = cache;
+	LeaveCriticalSection(&depot->lock);
+
+	TlsSetValue(_csmint.allocTls, cache);
+	return cache;
+}
+
+static __forceinline void _pushFreeBlock(PCIThreadCache cache, UINT32 sizeClass, PCIFreeBlock block) {
+	block->next = cache->freeLists[sizeClass];
+	cache->freeLists[sizeClass] = block;
+	cache->freeCounts[sizeClass]++;
+}
+
+static void _refillSizeClass(PCIThreadCache cache, UINT32 sizeClass) {
+	PCIAllocDepot depot = _csmint.allocDepot;
+
+	// take back blocks freed by other threads first
+	EnterCriticalSection(&depot->lock);
+	for (UINT32 blockID = 0; blockID < CSMINT_ALLOC_BATCH_SIZE; blockID++) {
+		PCIFreeBlock block = depot->freeLists[sizeClass];
+		if (block == NULL) break;
+		depot->freeLists[sizeClass] = block->next;
+		_pushFreeBlock(cache, sizeClass, block);
+	}
+	LeaveCriticalSection(&depot->lock);
+
+	if (cache->freeLists[sizeClass] != NULL) return;
+
+	// otherwise carve a new slab into blocks
+	// note: slabs are never returned before the heap is destroyed
+	SIZE_T blockSize = (SIZE_T)CSMINT_ALLOC_MIN_BLOCK << sizeClass;
+	PBYTE  slab = HeapAlloc(_csmint.heap, ZERO, CSMINT_ALLOC_SLAB_SIZE);
+	for (SIZE_T offset = 0; offset + blockSize <= CSMINT_ALLOC_SLAB_SIZE; offset += blockSize)
+		_pushFreeBlock(cache, sizeClass, (PCIFreeBlock)(slab + offset));
+}
+
+static void _returnSizeClass(PCIThreadCache cache, UINT32 sizeClass) {
+	PCIAllocDepot depot = _csmint.allocDepot;
+
+	// give a batch to the depot so other threads can use it
+	EnterCriticalSection(&depot->lock);
+	for (UINT32 blockID = 0; blockID < CSMINT_ALLOC_BATCH_SIZE; blockID++) {
+		PCIFreeBlock block = cache->freeLists[sizeClass];
+		cache->freeLists[sizeClass] = block->next;
+		cache->freeCounts[sizeClass]--;
+		block->next = depot->freeLists[sizeClass];
+		depot->freeLists[sizeClass] = block;
+	}
+	LeaveCriticalSection(&depot->lock);
+}
+
+static __forceinline UINT32 _findSizeClass(SIZE_T blockSize) {
+	UINT32 sizeClass = 0;
+	while (sizeClass < CSMINT_ALLOC_LARGE_CLASS &&
+		((SIZE_T)CSMINT_ALLOC_MIN_BLOCK << sizeClass) < blockSize)
+		sizeClass++;
+	return sizeClass;
+}
+
+PVOID CInternalAllocUnzeroed(SIZE_T size) {
+	PCIThreadCache cache = _getThreadCache();
+	cache->allocateCount++;
+
+	SIZE_T blockSize = size + sizeof(CIAllocHeader);
+	UINT32 sizeClass = _findSizeClass(blockSize);
+
+	PCIAllocHeader header;
+	if (sizeClass == CSMINT_ALLOC_LARGE_CLASS) {
+		header = HeapAlloc(_csmint.heap, ZERO, blockSize);
+	}
+	else {
+		if (cache->freeLists[sizeClass] == NULL)
+			_refillSizeClass(cache, sizeClass);
+
+		PCIFreeBlock block = cache->freeLists[sizeClass];
+		cache->freeLists[sizeClass] = block->next;
+		cache->freeCounts[sizeClass]--;
+		header = (PCIAllocHeader)block;
+	}
+
+	header->sizeClass = sizeClass;
+	return header + 1;
+}
+
 PVOID CInternalAlloc(SIZE_T size) {
-	_CSyncEnter();
-	PVOID block = HeapAlloc(_csmint.heap, ZERO, size);
+	PVOID block = CInternalAllocUnzeroed(size);
 	ZERO_BYTES(block, size);
-	_csmint.allocateCount++;
-	_CSyncLeave(block);
+	return block;
 }
 
 void  CInternalFree(PVOID ptr) {
-	_CSyncEnter();
-	HeapFree(_csmint.heap, ZERO, ptr);
-	_csmint.allocateCount--;
-	_CSyncLeave();
+	if (ptr == NULL) return;
+
+	PCIThreadCache cache = _getThreadCache();
+	cache->allocateCount--;
+
+	PCIAllocHeader header	 = (PCIAllocHeader)ptr - 1;
+	UINT32		   sizeClass = (UINT32)header->sizeClass;
+	if (sizeClass == CSMINT_ALLOC_LARGE_CLASS) {
+		HeapFree(_csmint.heap, ZERO, header);
+		return;
+	}
+
+	_pushFreeBlock(cache, sizeClass, (PCIFreeBlock)header);
+	if (cache->freeCounts[sizeClass] > CSMINT_ALLOC_CACHE_LIMIT)
+		_returnSizeClass(cache, sizeClass);
+}
+
+static __forceinline PCIArenaBlock _makeArenaBlock(SIZE_T minSize) {
+	SIZE_T blockSize = max(CSMINT_ARENA_BLOCK_SIZE, minSize + CSMINT_ARENA_ALIGNMENT);
+	PCIArenaBlock block = CInternalAlloc(sizeof(CIArenaBlock));
+	block->sizeBytes = blockSize;
+	block->data = CInternalAllocUnzeroed(blockSize);
+	return block;
+}
+
+PCIArena CInternalMakeArena(void) {
+	PCIArena arena = CInternalAlloc(sizeof(CIArena));
+	arena->firstBlock = _makeArenaBlock(ZERO);
+	arena->currentBlock = arena->firstBlock;
+	return arena;
+}
+
+void CInternalDestroyArena(PCIArena arena) {
+	PCIArenaBlock block = arena->firstBlock;
+	while (block != NULL) {
+		PCIArenaBlock next = block->next;
+		CInternalFree(block->data);
+		CInternalFree(block);
+		block = next;
+	}
+	CInternalFree(arena);
+}
+
+PVOID CInternalArenaAlloc(PCIArena arena, SIZE_T size) {
+	PCIArenaBlock block = arena->currentBlock;
+
+	while (TRUE) {
+		// align from the actual address so alignment holds regardless of block base
+		ULONG_PTR base    = (ULONG_PTR)(block->data + block->usedBytes);
+		ULONG_PTR aligned = (base + (CSMINT_ARENA_ALIGNMENT - 1)) & ~((ULONG_PTR)CSMINT_ARENA_ALIGNMENT - 1);
+		SIZE_T    offset  = block->usedBytes + (aligned - base);
+
+		if (offset + size <= block->sizeBytes) {
+			block->usedBytes = offset + size;
+			arena->currentBlock = block;
+			return (PVOID)aligned;
+		}
+
+		// move to next block, creating one if none are left
+		if (block->next == NULL)
+			block->next = _makeArenaBlock(size);
+		block = block->next;
+	}
+}
+
+void CInternalArenaReset(PCIArena arena) {
+	// keep all blocks, only rewind them
+	for (PCIArenaBlock block = arena->firstBlock; block != NULL; block = block->next)
+		block->usedBytes = 0;
+	arena->currentBlock = arena->firstBlock;
 }
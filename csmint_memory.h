@@ -8,7 +8,65 @@
 #include "csm.h"
 #include "csmint.h"
 
+#define CSMINT_ARENA_BLOCK_SIZE		0x10000
+#define CSMINT_ARENA_ALIGNMENT		0x20
+
+// small blocks come from per-thread free lists of doubling size classes,
+// larger blocks come straight from the heap
+#define CSMINT_ALLOC_MIN_BLOCK		0x20
+#define CSMINT_ALLOC_CLASS_COUNT	0x0A	// blocks up to 16KB, header included
+#define CSMINT_ALLOC_LARGE_CLASS	CSMINT_ALLOC_CLASS_COUNT
+#define CSMINT_ALLOC_SLAB_SIZE		0x10000
+#define CSMINT_ALLOC_CACHE_LIMIT	0x80	// blocks per class a thread keeps before giving back
+#define CSMINT_ALLOC_BATCH_SIZE		0x40	// blocks moved between a thread and the depot at once
+
+// note: keeps blocks 16 byte aligned
+typedef struct CIAllocHeader {
+	SIZE_T sizeClass;
+	SIZE_T reserved;
+} CIAllocHeader, *PCIAllocHeader;
+
+typedef struct CIFreeBlock {
+	struct CIFreeBlock* next;
+} CIFreeBlock, *PCIFreeBlock;
+
+typedef struct CIThreadCache {
+	struct CIThreadCache* next;			// all caches, summed for leak checks
+	PCIFreeBlock freeLists[CSMINT_ALLOC_CLASS_COUNT];
+	UINT32		 freeCounts[CSMINT_ALLOC_CLASS_COUNT];
+	LONG		 allocateCount;			// only written by the owning thread, may be negative
+} CIThreadCache, *PCIThreadCache;
+
+// shared blocks, so blocks freed on another thread than they were allocated on are reused
+typedef struct CIAllocDepot {
+	CRITICAL_SECTION lock;
+	PCIFreeBlock	 freeLists[CSMINT_ALLOC_CLASS_COUNT];
+	PCIThreadCache	 caches;
+} CIAllocDepot, *PCIAllocDepot;
+
+void  CInternalInitAllocator(void);
+LONG  CInternalAllocCount(void); // allocations not yet freed, across all threads
 PVOID CInternalAlloc(SIZE_T size);
+PVOID CInternalAllocUnzeroed(SIZE_T size); // for memory that is overwritten right away
 void  CInternalFree(PVOID ptr);
 
+// bump allocator used for per-draw scratch memory
+// blocks are kept between resets so steady-state draws never touch the heap
+typedef struct CIArenaBlock {
+	struct CIArenaBlock* next;
+	SIZE_T sizeBytes;
+	SIZE_T usedBytes;
+	PBYTE  data;
+} CIArenaBlock, *PCIArenaBlock;
+
+typedef struct CIArena {
+	PCIArenaBlock firstBlock;
+	PCIArenaBlock currentBlock;
+} CIArena, *PCIArena;
+
+PCIArena CInternalMakeArena(void);
+void	 CInternalDestroyArena(PCIArena arena);
+PVOID	 CInternalArenaAlloc(PCIArena arena, SIZE_T size); // note: memory is NOT zeroed
+void	 CInternalArenaReset(PCIArena arena);
+
 #endif
@@ -9,8 +9,18 @@
 #include "csm_mesh.h"
 #include "csm_draw.h"
 #include "csm_vertex.h"
+#include "csm_fragment.h"
 
 #define CSMINT_CLIP_PLANE_POSITION	-1.0f
+#define CSMINT_TILE_SIZE			0x40
+#define CSMINT_BIN_CHUNK_SIZE		0x100
+#define CSMINT_RESOLVE_BAND_ROWS	0x10
+#define CSMINT_SPAN_WIDTH			0x08
+#define CSMINT_HIZ_DEPTH_ERROR		(1.0f / 1024.0f) // bound of per-pixel reciprocal error
+
+#if CSMINT_SPAN_WIDTH != CSM_RENDERBUFFER_HIZ_BLOCK_SIZE
+#error "rasterizer expects one span per coarse depth block row"
+#endif
 
 typedef struct CIPVertOutput {
 	UINT32 componentCount;
@@ -21,36 +31,267 @@ typedef struct CIPVertOutputList {
 	CIPVertOutput outputs[CSM_MAX_VERTEX_OUTPUTS];
 } CIPVertOutputList, *PCIPVertOutputList;
 
+#define CSMINT_MAX_VARYING_FLOATS	(CSM_MAX_VERTEX_OUTPUTS * CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS)
+
+// packed layout of the vertex outputs that are live for a triangle
+// note: discovered from the outputs written for the triangle's first vertex,
+// layouts are shared by every triangle of a draw with the same outputs
+typedef struct CIPVaryingLayout {
+	struct CIPVaryingLayout* next;
+	UINT32 floatCount;	// packed floats per vertex
+	UINT32 count;		// live outputs
+	UINT32 outputIDs[CSM_MAX_VERTEX_OUTPUTS];		// live outputs in packed order
+	UINT32 componentCounts[CSM_MAX_VERTEX_OUTPUTS]; // by outputID, 0 when not live
+	UINT32 offsets[CSM_MAX_VERTEX_OUTPUTS];			// by outputID, float offset when packed
+} CIPVaryingLayout, *PCIPVaryingLayout;
+
+// note: triangles are variable size, varyingValues holds 3 * varyings->floatCount floats
 typedef struct CIPTriData {
-	CIPVertOutputList vertOutputs[3];
+	PCIPVaryingLayout varyings;
 	CVect3F verts[3];
 	FLOAT	invDepths[3]; // cache W val to avoid per-fragment float division
+	FLOAT	varyingValues[];
 } CIPTriData, *PCIPTriData;
 
+#define CSMINT_TRI_DATA_SIZE(floatCount) \
+	(sizeof(CIPTriData) + (sizeof(FLOAT) * 3 * (floatCount)))
+#define CSMINT_TRI_VARYINGS(tri, triVertex) \
+	((tri)->varyingValues + ((triVertex) * (tri)->varyings->floatCount))
+
 typedef struct CIPFragContext {
 	struct CIPTriContext*	parent;
-	CIPVertOutputList		fragInputs;
+	PCIPVaryingLayout		varyings;
+	FLOAT					fragInputs[CSMINT_MAX_VARYING_FLOATS]; // packed by varyings
 	CFragPos				fragPos;
 	CVect3F					barycentricWeightings;
+	BOOL					outputIsFloat; // set by CFragmentSetOutputFloat4
+	CVect4F					outputFloat;
+
+	// change in perspective correct weights per pixel across the 2x2 quad holding the
+	// fragment, made on first use for each quad, see CInternalPipelineQuadDerivatives
+	struct CIPEdgeSetup*	edges; // of the triangle being shaded
+	INT						quadX, quadY; // quadX is -1 when no quad was made yet
+	CVect3F					quadWeightsDX;
+	CVect3F					quadWeightsDY;
 } CIPFragContext, * PCIPFragContext;
 
+// post-transform cache entry, one per mesh vertex per material slot
+// note: outputs are kept packed, storage is reused by later instances while it fits
+typedef struct CIPVertCacheEntry {
+	UINT32			  stamp;	// instanceID + 1 of the instance that shaded this entry
+	UINT32			  capacity;	// floats that values can hold
+	CVect3F			  position;
+	PCIPVaryingLayout layout;
+	PFLOAT			  values;	// packed by layout
+} CIPVertCacheEntry, *PCIPVertCacheEntry;
+
+typedef struct CIPVertCache {
+	PCIArena		   arena;
+	PCRenderClass	   rClass;
+	UINT32			   vertCount;
+	PCIPVertCacheEntry slots[CSM_CLASS_MAX_MATERIALS]; // lazily made per material slot
+	PUINT32			   slotVerts[CSM_CLASS_MAX_MATERIALS]; // unique vertices, batched only
+	UINT32			   slotVertCounts[CSM_CLASS_MAX_MATERIALS];
+	PCVertexBatch	   batch; // lazily made on first batched shade
+	PCIPVaryingLayout  layouts; // every distinct layout of this draw
+	CIPVertOutputList  shaded;	// outputs of the vertex being shaded, packed once done
+} CIPVertCache, *PCIPVertCache;
+
+typedef struct CIPRect {
+	INT minX, minY;
+	INT maxX, maxY; // inclusive
+} CIPRect, *PCIPRect;
+
+// draw recorded into the visibility buffer, kept until the next resolve shades it
+typedef struct CIPVisDraw {
+	struct CIPVisDraw*	next;
+	PCRenderClass		rClass;
+	PCDrawInput			drawInputs; // copied, the context's inputs may change before the resolve
+	PCStaticDataVersion staticData[CSM_CLASS_MAX_STATIC_DATA]; // pinned until resolved
+	PCIPVaryingLayout	layoutSource; // layouts live in the draw's arena, so the last one
+	PCIPVaryingLayout	layoutCopy;	  // recorded is copied and reused while it repeats
+} CIPVisDraw, *PCIPVisDraw;
+
+// visibility buffer draws waiting for a resolve
+typedef struct CIPVisState {
+	PCIArena	arena;	// draws and their triangles, reset by every resolve
+	PCIPVisDraw draws;	// most recent first
+	CIPRect		dirty;	// pixels that may hold a triangle, empty when maxX < minX
+} CIPVisState, *PCIPVisState;
+
 typedef struct CIPTriContext {
-	PCDrawContext	drawContext;
-	UINT32			triVertexID;	// only applicable for vertex shader
-	UINT32			vertexID;		// only applicable for vertex shader
-	UINT32			instanceID;
-	UINT32			triangleID;
-	PCRenderClass	rClass;
-	PCIPTriData		screenTriAndData;
-	CIPFragContext  fragContext;
-	PCRenderBuffer	renderBuffer;
-	PCMaterial		material;
+	PCDrawContext		drawContext;
+	PCDrawInput			drawInputs;		// inputs of the draw, may be a recorded snapshot
+	UINT32				triVertexID;	// only applicable for vertex shader
+	UINT32				vertexID;		// only applicable for vertex shader
+	PCIPVertOutputList	vertOutputs;	// only applicable for vertex shader
+	UINT32				instanceID;
+	UINT32				triangleID;
+	PCRenderClass		rClass;
+	CVertexStream		vertexStreams[CSM_CLASS_MAX_VERTEX_DATA]; // data is NULL when unbound
+	PCStaticDataVersion staticData[CSM_CLASS_MAX_STATIC_DATA]; // pinned for the whole draw
+	PCIPTriData			screenTriAndData;
+	CIPFragContext		fragContext;
+	PCRenderBuffer		renderBuffer;
+	PCMaterial			material;
+	UINT32				materialSlot;
+	PCIPVertCache		vertCache;
+	CIPRect				scissor; // rasterization is limited to this rect
+	CDepthTest			depthTest;
+	BOOL				depthOnly; // no fragment stage, only depth is written
+	struct CIPTriRecord** visBuffer; // per pixel, only in visibility buffer mode
+	struct CIPTriRecord*  visRecord; // record of the triangle being rasterized
+	PCIPVisState		  vis;		 // pending draws, only in visibility buffer mode
 } CIPTriContext, * PCIPTriContext;
 
+// per-triangle edge function setup
+// note: edge i is opposite vertex i and is normalized by the triangle area so that
+// evaluating it at a pixel directly gives barycentric weight i
+typedef struct CIPEdgeSetup {
+	FLOAT stepX[3];		// change in weight per pixel
+	FLOAT stepY[3];		// change in weight per row
+	FLOAT origin[3];	// weight at (0, 0)
+	BOOL  owned[3];		// top-left rule, pixels exactly on an owned edge are drawn
+	FLOAT invWStepX;	// inverse depth is also linear in screen space
+	FLOAT invWStepY;
+	FLOAT invWOrigin;
+	FLOAT invDepths[3];
+} CIPEdgeSetup, *PCIPEdgeSetup;
+
+// results of evaluating up to CSMINT_SPAN_WIDTH pixels of one row
+typedef struct CIPSpan {
+	UINT32 mask; // bit i is set when pixel i is covered and passes the early depth test
+	FLOAT  depths[CSMINT_SPAN_WIDTH];
+	FLOAT  weights[3][CSMINT_SPAN_WIDTH];	  // screen space barycentrics
+	FLOAT  perspWeights[3][CSMINT_SPAN_WIDTH]; // perspective correct barycentrics
+} CIPSpan, *PCIPSpan;
+
+// note: spanDepths points at the stored depth of pixel x, the span never leaves one
+// coarse depth block row so its depths are contiguous in every render buffer layout
+// note: spanDepths may be NULL when every pixel is known to pass the depth test
+typedef void (*PCIPSpanKernelProc)(PCIPEdgeSetup edges, INT x, INT y, UINT32 count,
+	PVOID spanDepths, CDepthFormat depthFormat, CDepthTest depthTest, PCIPSpan span);
+
+// screen-space triangle kept for later rasterization or shading
+// note: used by tile bins and by the visibility buffer
+typedef struct CIPTriRecord {
+	PCIPTriData	tri; // sized to its varyings
+	UINT32		instanceID;
+	UINT32		triangleID;
+	PCMaterial	material;
+	PCIPVisDraw	visDraw; // draw to shade with, only in the visibility buffer
+} CIPTriRecord, *PCIPTriRecord;
+
+typedef struct CIPBinChunk {
+	struct CIPBinChunk* next;
+	UINT32			    count;
+	PCIPTriRecord	    tris[CSMINT_BIN_CHUNK_SIZE];
+} CIPBinChunk, *PCIPBinChunk;
+
+typedef struct CIPTileBin {
+	PCIPBinChunk first;
+	PCIPBinChunk last;
+} CIPTileBin, *PCIPTileBin;
+
+typedef struct CIPBinContext {
+	PCIArena		arena;
+	PCIPTriContext	baseContext;
+	UINT32			tilesX, tilesY;
+	PCIPTileBin		bins;
+	PCIPTriContext	workerContexts; // one per worker
+} CIPBinContext, *PCIPBinContext;
+
+typedef struct CIPResolveContext {
+	PCIPTriContext	baseContext;
+	PCIPTriContext	workerContexts; // one per worker
+} CIPResolveContext, *PCIPResolveContext;
+
+PCIPVertCache CInternalPipelineMakeVertCache(PCIArena arena, PCRenderClass rClass);
+UINT32 CInternalPipelineResolveMaterialSlot(PCRenderClass rClass, UINT32 triangleID);
 void   CInternalPipelineProcessTri(PCIPTriContext triContext, PCIPTriData inTri);
-UINT32 CInternalPipelineClipTri(PCIPTriData inTri, PCIPTriData outTriArray);
+UINT32 CInternalPipelineClipTri(PCIPTriData inTri, PCIPTriData* outTris);
 void   CInternalPipelineProjectTri(PCRenderBuffer renderBuffer, PCIPTriData tri);
 void   CInternalPipelineRasterizeTri(PCIPTriContext triContext, PCIPTriData subTri);
+void   CInternalPipelineResolveVisBuffer(PCIPTriContext triContext); // within scissor
+void   CInternalPipelineQuadDerivatives(PCIPFragContext fContext);
+
+// implemented in <csmint_pl_bintri.c>
+BOOL		   CInternalPipelineTriBounds(PCRenderBuffer renderBuffer, PCIPTriData tri,
+	PCIPRect boundsOut); // FALSE when the triangle covers no pixel
+PCIPTriRecord  CInternalPipelineRecordTri(PCIArena arena, PCIPTriContext triContext,
+	PCIPTriData tri);
+PCIPTriRecord  CInternalPipelineRecordVisTri(PCIPTriContext triContext, PCIPTriData tri,
+	CIPRect bounds);
+PCIPBinContext CInternalPipelineBeginBinning(PCIArena arena, PCIPTriContext baseContext);
+void		   CInternalPipelineBinTri(PCIPBinContext binContext, PCIPTriContext triContext,
+	PCIPTriData tri);
+void		   CInternalPipelineRasterizeBins(PCIPBinContext binContext);
+void		   CInternalPipelineResolveVisBands(PCIArena arena, PCIPTriContext baseContext);
+
+// implemented in <csmint_pl_spankernel.c>
+// note: kernel is chosen once by cpu features, AVX2 when available and SSE2 otherwise
+PCIPSpanKernelProc CInternalPipelineGetSpanKernel(void);
+
+// index of a pixel within the color and depth planes of a render buffer
+// note: the pixels of one coarse depth block row are contiguous in every layout
+#define CSMINT_RB_TILE_MASK	(CSM_RENDERBUFFER_HIZ_BLOCK_SIZE - 1)
+#define CSMINT_RB_PIXEL_INDEX(rb, x, y) \
+	(((rb)->layout == CRenderBufferLayout_Tiled) ? \
+		(((((y) >> CSM_RENDERBUFFER_TILE_SHIFT) * (rb)->hizWidth + ((x) >> CSM_RENDERBUFFER_TILE_SHIFT)) \
+			<< (CSM_RENDERBUFFER_TILE_SHIFT * 2)) + \
+			(((y) & CSMINT_RB_TILE_MASK) << CSM_RENDERBUFFER_TILE_SHIFT) + ((x) & CSMINT_RB_TILE_MASK)) : \
+		((x) + (((rb)->height - (y) - 1) * (rb)->width)))
+
+// 16 bit depth maps CSM_RENDERBUFFER_MAX_DEPTH to 0 and 0 to the largest value
+// note: depths are rounded to nearest in every kernel and in the render buffer alike
+#define CSMINT_DEPTH16_MAX		65535.0f
+#define CSMINT_DEPTH16_SCALE	(CSMINT_DEPTH16_MAX / -CSM_RENDERBUFFER_MAX_DEPTH)
+#define CSMINT_DEPTH_BYTES(format) \
+	(((format) == CDepthFormat_Unorm16) ? sizeof(UINT16) : sizeof(FLOAT))
+#define CSMINT_COLOR_BYTES(format) \
+	(((format) == CColorFormat_RGB565) ? sizeof(UINT16) : \
+	 ((format) == CColorFormat_RGBA32F) ? sizeof(CVect4F) : sizeof(CColor))
+#define CSMINT_RB_DEPTH_PTR(rb, x, y) \
+	((PBYTE)(rb)->depth + (CSMINT_RB_PIXEL_INDEX(rb, x, y) * CSMINT_DEPTH_BYTES((rb)->depthFormat)))
+
+// planes a tile still owes a clear to, tiles are the same as coarse depth blocks
+#define CSMINT_RB_CLEAR_COLOR	0x01
+#define CSMINT_RB_CLEAR_DEPTH	0x02
+#define CSMINT_RB_TILE_ID(rb, x, y) \
+	(((x) >> CSM_RENDERBUFFER_TILE_SHIFT) + (((y) >> CSM_RENDERBUFFER_TILE_SHIFT) * (rb)->hizWidth))
+
+// implemented in <csm_renderbuffer.c>
+FLOAT CInternalRenderBufferHiZMin(PCRenderBuffer rb, UINT32 blockX, UINT32 blockY);
+BOOL  CInternalRenderBufferWriteDepth(PCRenderBuffer rb, INT x, INT y, FLOAT depth); // depth tested
+CColor CInternalRenderBufferReadColor(PCRenderBuffer rb, INT x, INT y);
+void  CInternalRenderBufferWriteColor(PCRenderBuffer rb, INT x, INT y, CColor color);
+void  CInternalRenderBufferBlendColor(PCRenderBuffer rb, INT x, INT y, CColor color); // by color alpha
+void  CInternalRenderBufferWriteColorFloat(PCRenderBuffer rb, INT x, INT y, CVect4F color); // blends too
+PCColor CInternalRenderBufferLinearColor(PCRenderBuffer rb); // bottom row first, for present
+void  CInternalRenderBufferResolveTile(PCRenderBuffer rb, UINT32 tileID); // fills owed clears
+
+// implemented in <csm_texture.c>
+FLOAT  CInternalTextureFindLod(PCTexture texture, CVect2F uvDX, CVect2F uvDY); // uv change per pixel
+CColor CInternalTextureSample(PCTexture texture, CVect2F uv, FLOAT lod, CSampleType sampleType,
+	CTextureFilter filter);
+// 4 uvs at one level of detail, same colors as 4 single samples
+void   CInternalTextureSample4(PCTexture texture, const CVect2F* uvs, FLOAT lod, CSampleType sampleType,
+	CTextureFilter filter, PCColor colorsOut);
+
+// implemented in <csm_renderclass.c>
+// note: lock free, classes are never modified while they are being drawn
+PCVertexDataBuffer CInternalRenderClassGetVertexDataBuffer(PCRenderClass rClass, UINT32 ID);
+PCStaticDataBuffer CInternalRenderClassGetStaticDataBuffer(PCRenderClass rClass, UINT32 ID);
+
+// implemented in <csm_buffer.c>
+// note: a pinned version stays readable until released, even after the buffer is unmapped
+PCStaticDataVersion CInternalStaticDataBufferPin(PCStaticDataBuffer sdBuffer);
+void				CInternalStaticDataVersionRelease(PCStaticDataVersion version);
+
+// implemented in <csm_draw.c>
+// note: must be called without the global lock held, inputs are read by the shaders
+void CInternalDrawInstanced(PCDrawContext context, PCRenderClass pClass, UINT32 instanceCount,
+	PCDrawInput inputs);
 
 // implemented in <csmint_pl_rasterizetri.c>
 CVect3F CInternalPipelineGenerateBarycentricWeights(PCIPTriData tri, CVect3F vert);
@@ -0,0 +1,194 @@
+// <csmint_pl_bintri.c>
+// Bailey Jia-Tao Brown
+// 2023
+
+#include "csmint_pipeline.h"
+#include "csm_renderbuffer.h"
+#include <math.h>
+
+static PCIPTriContext _makeWorkerContexts(PCIArena arena, PCIPTriContext baseContext) {
+	const UINT32 workerCount = CInternalWorkerCount();
+	PCIPTriContext workerContexts = CInternalArenaAlloc(arena, sizeof(CIPTriContext) * workerCount);
+	for (UINT32 workerID = 0; workerID < workerCount; workerID++) {
+		PCIPTriContext workerContext = workerContexts + workerID;
+		COPY_BYTES(baseContext, workerContext, sizeof(CIPTriContext));
+		workerContext->fragContext.parent = workerContext;
+	}
+	return workerContexts;
+}
+
+PCIPBinContext CInternalPipelineBeginBinning(PCIArena arena, PCIPTriContext baseContext) {
+	PCIPBinContext binContext = CInternalArenaAlloc(arena, sizeof(CIPBinContext));
+	PCRenderBuffer renderBuffer = baseContext->renderBuffer;
+
+	binContext->arena		= arena;
+	binContext->baseContext = baseContext;
+	binContext->tilesX = (renderBuffer->width  + CSMINT_TILE_SIZE - 1) / CSMINT_TILE_SIZE;
+	binContext->tilesY = (renderBuffer->height + CSMINT_TILE_SIZE - 1) / CSMINT_TILE_SIZE;
+
+	// make empty bins
+	const SIZE_T binsSize = sizeof(CIPTileBin) * binContext->tilesX * binContext->tilesY;
+	binContext->bins = CInternalArenaAlloc(arena, binsSize);
+	ZERO_BYTES(binContext->bins, binsSize);
+
+	// make per-worker scratch, each worker rasterizes with its own context
+	binContext->workerContexts = _makeWorkerContexts(arena, baseContext);
+
+	return binContext;
+}
+
+PCIPTriRecord CInternalPipelineRecordTri(PCIArena arena, PCIPTriContext triContext,
+	PCIPTriData tri) {
+	// note: only the triangle's live varyings are copied
+	const SIZE_T triSize = CSMINT_TRI_DATA_SIZE(tri->varyings->floatCount);
+	PCIPTriRecord record = CInternalArenaAlloc(arena, sizeof(CIPTriRecord));
+	record->tri = CInternalArenaAlloc(arena, triSize);
+	COPY_BYTES(tri, record->tri, triSize);
+	record->instanceID = triContext->instanceID;
+	record->triangleID = triContext->triangleID;
+	record->material   = triContext->material;
+	record->visDraw	   = NULL;
+	return record;
+}
+
+PCIPTriRecord CInternalPipelineRecordVisTri(PCIPTriContext triContext, PCIPTriData tri,
+	CIPRect bounds) {
+	// visible pixels are shaded by a later resolve, so records live with the draw
+	PCIPVisState vis = triContext->vis;
+	PCIPTriRecord record = CInternalPipelineRecordTri(vis->arena, triContext, tri);
+	PCIPVisDraw draw = vis->draws;
+	record->visDraw = draw;
+
+	if (draw->layoutSource != tri->varyings) {
+		draw->layoutCopy = CInternalArenaAlloc(vis->arena, sizeof(CIPVaryingLayout));
+		COPY_BYTES(tri->varyings, draw->layoutCopy, sizeof(CIPVaryingLayout));
+		draw->layoutSource = tri->varyings;
+	}
+	record->tri->varyings = draw->layoutCopy;
+
+	// the resolve only walks pixels that may hold a triangle
+	vis->dirty.minX = min(vis->dirty.minX, bounds.minX);
+	vis->dirty.minY = min(vis->dirty.minY, bounds.minY);
+	vis->dirty.maxX = max(vis->dirty.maxX, bounds.maxX);
+	vis->dirty.maxY = max(vis->dirty.maxY, bounds.maxY);
+	return record;
+}
+
+static __forceinline void _appendToBin(PCIPBinContext binContext, PCIPTileBin bin, PCIPTriRecord record) {
+	// make new chunk if needed
+	if (bin->last == NULL || bin->last->count == CSMINT_BIN_CHUNK_SIZE) {
+		PCIPBinChunk chunk = CInternalArenaAlloc(binContext->arena, sizeof(CIPBinChunk));
+		chunk->next  = NULL;
+		chunk->count = 0;
+
+		if (bin->last == NULL) bin->first = chunk;
+		else bin->last->next = chunk;
+		bin->last = chunk;
+	}
+
+	bin->last->tris[bin->last->count] = record;
+	bin->last->count++;
+}
+
+BOOL CInternalPipelineTriBounds(PCRenderBuffer renderBuffer, PCIPTriData tri, PCIPRect boundsOut) {
+	// same pixel bounds as the rasterizer, pixels are sampled at integer coordinates
+	FLOAT minX = ceilf(min(tri->verts[0].x, min(tri->verts[1].x, tri->verts[2].x)));
+	FLOAT maxX = floorf(max(tri->verts[0].x, max(tri->verts[1].x, tri->verts[2].x)));
+	FLOAT minY = ceilf(min(tri->verts[0].y, min(tri->verts[1].y, tri->verts[2].y)));
+	FLOAT maxY = floorf(max(tri->verts[0].y, max(tri->verts[1].y, tri->verts[2].y)));
+
+	// on bad values, skip (rasterizer would not draw these either)
+	if (isnan(minX) || isnan(maxX) || isnan(minY) || isnan(maxY)) return FALSE;
+
+	// triangles that fall between pixel centers cover nothing
+	if (minX > maxX || minY > maxY) return FALSE;
+
+	// cull if completely offscreen
+	const FLOAT lastX = (FLOAT)renderBuffer->width  - 1.0f;
+	const FLOAT lastY = (FLOAT)renderBuffer->height - 1.0f;
+	if (maxX < 0.0f || maxY < 0.0f) return FALSE;
+	if (minX > lastX || minY > lastY) return FALSE;
+
+	// clamp to screen before converting to avoid int overflow
+	boundsOut->minX = (INT)max(0.0f, minX);
+	boundsOut->minY = (INT)max(0.0f, minY);
+	boundsOut->maxX = (INT)min(lastX, maxX);
+	boundsOut->maxY = (INT)min(lastY, maxY);
+	return TRUE;
+}
+
+void CInternalPipelineBinTri(PCIPBinContext binContext, PCIPTriContext triContext,
+	PCIPTriData tri) {
+	CIPRect bounds;
+	if (CInternalPipelineTriBounds(triContext->renderBuffer, tri, &bounds) == FALSE) return;
+
+	// copy triangle and state needed to rasterize it later
+	PCIPTriRecord record;
+	if (triContext->vis != NULL)
+		record = CInternalPipelineRecordVisTri(triContext, tri, bounds);
+	else
+		record = CInternalPipelineRecordTri(binContext->arena, triContext, tri);
+
+	// add to every overlapped tile
+	for (INT tileY = bounds.minY / CSMINT_TILE_SIZE; tileY <= bounds.maxY / CSMINT_TILE_SIZE; tileY++) {
+		for (INT tileX = bounds.minX / CSMINT_TILE_SIZE; tileX <= bounds.maxX / CSMINT_TILE_SIZE; tileX++) {
+			PCIPTileBin bin = binContext->bins + (tileY * binContext->tilesX) + tileX;
+			_appendToBin(binContext, bin, record);
+		}
+	}
+}
+
+static void _rasterizeTileJob(PVOID param, UINT32 tileIndex, UINT32 workerIndex) {
+	PCIPBinContext binContext	= param;
+	PCIPTileBin	   bin			= binContext->bins + tileIndex;
+	PCIPTriContext tContext		= binContext->workerContexts + workerIndex;
+	PCRenderBuffer renderBuffer = tContext->renderBuffer;
+
+	// limit rasterization to this tile, tiles have exactly one owner so
+	// color and depth can be written without any locking
+	INT tileX = tileIndex % binContext->tilesX;
+	INT tileY = tileIndex / binContext->tilesX;
+	tContext->scissor.minX = tileX * CSMINT_TILE_SIZE;
+	tContext->scissor.minY = tileY * CSMINT_TILE_SIZE;
+	tContext->scissor.maxX = min((INT)renderBuffer->width  - 1, tContext->scissor.minX + CSMINT_TILE_SIZE - 1);
+	tContext->scissor.maxY = min((INT)renderBuffer->height - 1, tContext->scissor.minY + CSMINT_TILE_SIZE - 1);
+
+	// draw in submission order so blending matches the serial backend
+	for (PCIPBinChunk chunk = bin->first; chunk != NULL; chunk = chunk->next) {
+		for (UINT32 binIndex = 0; binIndex < chunk->count; binIndex++) {
+			PCIPTriRecord record = chunk->tris[binIndex];
+
+			tContext->instanceID = record->instanceID;
+			tContext->triangleID = record->triangleID;
+			tContext->material	 = record->material;
+			tContext->visRecord	 = record;
+			CInternalPipelineRasterizeTri(tContext, record->tri);
+		}
+	}
+}
+
+void CInternalPipelineRasterizeBins(PCIPBinContext binContext) {
+	CInternalWorkerRun(_rasterizeTileJob, binContext, binContext->tilesX * binContext->tilesY);
+}
+
+static void _resolveBandJob(PVOID param, UINT32 bandIndex, UINT32 workerIndex) {
+	PCIPResolveContext resolveContext = param;
+	PCIPTriContext	   tContext		  = resolveContext->workerContexts + workerIndex;
+	CIPRect			   scissor		  = resolveContext->baseContext->scissor;
+
+	// every pixel holds at most one triangle, so bands of rows shade independently
+	tContext->scissor	   = scissor;
+	tContext->scissor.minY = scissor.minY + (INT)(bandIndex * CSMINT_RESOLVE_BAND_ROWS);
+	tContext->scissor.maxY = min(scissor.maxY, tContext->scissor.minY + CSMINT_RESOLVE_BAND_ROWS - 1);
+	CInternalPipelineResolveVisBuffer(tContext);
+}
+
+void CInternalPipelineResolveVisBands(PCIArena arena, PCIPTriContext baseContext) {
+	PCIPResolveContext resolveContext = CInternalArenaAlloc(arena, sizeof(CIPResolveContext));
+	resolveContext->baseContext	   = baseContext;
+	resolveContext->workerContexts = _makeWorkerContexts(arena, baseContext);
+
+	UINT32 rowCount = (UINT32)(baseContext->scissor.maxY - baseContext->scissor.minY + 1);
+	CInternalWorkerRun(_resolveBandJob, resolveContext,
+		(rowCount + CSMINT_RESOLVE_BAND_ROWS - 1) / CSMINT_RESOLVE_BAND_ROWS);
+}
@@ -52,33 +52,21 @@ static __forceinline FLOAT _vectDist(CVect3F v1, CVect3F v2) {
 	return sqrtf(dx * dx + dy * dy + dz * dz);
 }
 
-static __forceinline void _genInterpolatedVertInputs(PCIPVertOutputList pList,
-	CVect3F p1, CVect3F p2, CVect3F pm, PCIPVertOutputList vp1, PCIPVertOutputList vp2) {
-	// loop all inputs
-	for (UINT32 inputID = 0; inputID < CSM_CLASS_MAX_VERTEX_DATA; inputID++) {
-		// get each individual input for each vert
-		PCIPVertOutput input1 = vp1->outputs + inputID;
-		PCIPVertOutput input2 = vp2->outputs + inputID;
-
-		// loop all components of each input (compcount WILL be the same for both unless mem corruption)
-		for (UINT32 component = 0; component < input1->componentCount; component++) {
-			// get values of each componenet
-			FLOAT val1 = input1->valueBuffer[component];
-			FLOAT val2 = input2->valueBuffer[component];
-
-			// generate range between two values
-			FLOAT range = val2 - val1;
-
-			// calculate distance between p1 and p2, p1 and pm
-			FLOAT d12 = _vectDist(p1, p2);
-			FLOAT d1m = _vectDist(p1, pm);
-
-			// interpolate between values based on dist from clipping plane
-			pList->outputs[inputID].componentCount = input1->componentCount;
-			pList->outputs[inputID].valueBuffer[component] =
-				val1 + (range * (d1m / d12));
-		}
-	}
+static __forceinline void _genInterpolatedVertInputs(PCIPVaryingLayout layout, PFLOAT pList,
+	CVect3F p1, CVect3F p2, CVect3F pm, PFLOAT vp1, PFLOAT vp2) {
+	// interpolate between values based on dist from clipping plane
+	// note: this is the same for every value so is only calculated once
+	FLOAT d12 = _vectDist(p1, p2);
+	FLOAT d1m = _vectDist(p1, pm);
+	FLOAT factor = d1m / d12;
+
+	// values are packed so every live component is walked at once
+	for (UINT32 value = 0; value < layout->floatCount; value++)
+		pList[value] = vp1[value] + ((vp2[value] - vp1[value]) * factor);
+}
+
+static __forceinline void _copyVertInputs(PCIPVaryingLayout layout, PFLOAT pList, PFLOAT src) {
+	COPY_BYTES(src, pList, sizeof(FLOAT) * layout->floatCount);
 }
 
 static __forceinline void _perpareTriWValues(PCIPTriData tri) {
@@ -87,12 +75,12 @@ static __forceinline void _perpareTriWValues(PCIPTriData tri) {
 	}
 }
 
-static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData outTriArray) {
+static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData* outTris) {
 	// depending on behind vertex, generate other 2
 	CVect3F v1 = { 0 }, v2 = { 0 }, v3 = { 0 };
 
 	// maintain all vertex input lists
-	PCIPVertOutputList vl1 = NULL, vl2 = NULL, vl3 = NULL;
+	PFLOAT vl1 = NULL, vl2 = NULL, vl3 = NULL;
 
 	// this is faster than some clever logic
 	switch (clipInfo.behindTriIndexes[0])
@@ -102,9 +90,9 @@ static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData outTriAr
 		v2 = clipInfo.tri->verts[1];
 		v3 = clipInfo.tri->verts[2];
 
-		vl1 = &clipInfo.tri->vertOutputs[0];
-		vl2 = &clipInfo.tri->vertOutputs[1];
-		vl3 = &clipInfo.tri->vertOutputs[2];
+		vl1 = CSMINT_TRI_VARYINGS(clipInfo.tri, 0);
+		vl2 = CSMINT_TRI_VARYINGS(clipInfo.tri, 1);
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 2);
 
 		break;
 	case 1:
@@ -112,9 +100,9 @@ static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData outTriAr
 		v1 = clipInfo.tri->verts[1]; // v1 is behind
 		v3 = clipInfo.tri->verts[2];
 
-		vl2 = &clipInfo.tri->vertOutputs[0];
-		vl1 = &clipInfo.tri->vertOutputs[1];
-		vl3 = &clipInfo.tri->vertOutputs[2];
+		vl2 = CSMINT_TRI_VARYINGS(clipInfo.tri, 0);
+		vl1 = CSMINT_TRI_VARYINGS(clipInfo.tri, 1);
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 2);
 
 		break;
 	case 2:
@@ -122,9 +110,9 @@ static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData outTriAr
 		v3 = clipInfo.tri->verts[1];
 		v1 = clipInfo.tri->verts[2]; // v1 is behind
 
-		vl2 = &clipInfo.tri->vertOutputs[0];
-		vl3 = &clipInfo.tri->vertOutputs[1];
-		vl1 = &clipInfo.tri->vertOutputs[2];
+		vl2 = CSMINT_TRI_VARYINGS(clipInfo.tri, 0);
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 1);
+		vl1 = CSMINT_TRI_VARYINGS(clipInfo.tri, 2);
 
 		break;
 	default:
@@ -136,57 +124,57 @@ static __forceinline void _clipTriCase1(_clipinfo clipInfo, PCIPTriData outTriAr
 	CVect3F mp1 = _genPlaneIntersectPoint(v1, v2);
 	CVect3F mp2 = _genPlaneIntersectPoint(v1, v3);
 
-	// interpolate inputs
-	CIPVertOutputList vil1 = { 0 }, vil2 = { 0 };
-	_genInterpolatedVertInputs(&vil1, v1, v2, mp1, vl1, vl2);
-	_genInterpolatedVertInputs(&vil2, v1, v3, mp2, vl1, vl3);
+	// interpolate inputs straight into the new triangles
+	PCIPVaryingLayout layout = clipInfo.tri->varyings;
+	outTris[0]->varyings = layout;
+	outTris[1]->varyings = layout;
+	_genInterpolatedVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 1), v1, v2, mp1, vl1, vl2);
+	_genInterpolatedVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[1], 1), v1, v3, mp2, vl1, vl3);
 
 	// generate new triangle 1
-	outTriArray[0].verts[0] = v2;
-	outTriArray[0].verts[1] = mp1;
-	outTriArray[0].verts[2] = v3;
-	_perpareTriWValues(outTriArray + 0);
+	outTris[0]->verts[0] = v2;
+	outTris[0]->verts[1] = mp1;
+	outTris[0]->verts[2] = v3;
+	_perpareTriWValues(outTris[0]);
 
-	outTriArray[0].vertOutputs[0] = *vl2;
-	outTriArray[0].vertOutputs[1] = vil1;
-	outTriArray[0].vertOutputs[2] = *vl3;
+	_copyVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 0), vl2);
+	_copyVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 2), vl3);
 
 	// generate new triangle 2
-	outTriArray[1].verts[0] = mp1;
-	outTriArray[1].verts[1] = mp2;
-	outTriArray[1].verts[2] = v3;
-	_perpareTriWValues(outTriArray + 1);
-
-	outTriArray[1].vertOutputs[0] = vil1;
-	outTriArray[1].vertOutputs[1] = vil2;
-	outTriArray[1].vertOutputs[2] = *vl3;
+	outTris[1]->verts[0] = mp1;
+	outTris[1]->verts[1] = mp2;
+	outTris[1]->verts[2] = v3;
+	_perpareTriWValues(outTris[1]);
+
+	_copyVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[1], 0), CSMINT_TRI_VARYINGS(outTris[0], 1));
+	_copyVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[1], 2), vl3);
 }
 
-static __forceinline _clipTriCase2(_clipinfo clipInfo, PCIPTriData outTriArray) {
+static __forceinline _clipTriCase2(_clipinfo clipInfo, PCIPTriData* outTris) {
 	// depending on 2 behind vertexes, generate final one
 	CVect3F v1 = { 0 }, v2 = { 0 }, v3 = { 0 }; // v3 is infront
 	v1 = clipInfo.tri->verts[clipInfo.behindTriIndexes[0]];
 	v2 = clipInfo.tri->verts[clipInfo.behindTriIndexes[1]];
 
 	// maintain all vertex input lists
-	PCIPVertOutputList vl1 = NULL, vl2 = NULL, vl3 = NULL;
-	vl1 = &clipInfo.tri->vertOutputs[clipInfo.behindTriIndexes[0]];
-	vl2 = &clipInfo.tri->vertOutputs[clipInfo.behindTriIndexes[1]];
+	PFLOAT vl1 = NULL, vl2 = NULL, vl3 = NULL;
+	vl1 = CSMINT_TRI_VARYINGS(clipInfo.tri, clipInfo.behindTriIndexes[0]);
+	vl2 = CSMINT_TRI_VARYINGS(clipInfo.tri, clipInfo.behindTriIndexes[1]);
 
 	// clever trick
 	switch (clipInfo.behindTriIndexes[0] + clipInfo.behindTriIndexes[1])
 	{
 	case 1:
 		v3 = clipInfo.tri->verts[2]; // 0 + 1 is 1 so remainder is 2
-		vl3 = &clipInfo.tri->vertOutputs[2];
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 2);
 		break;
 	case 2:
 		v3 = clipInfo.tri->verts[1]; // 0 + 2 is 2 so remainder is 1
-		vl3 = &clipInfo.tri->vertOutputs[1];
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 1);
 		break;
 	case 3:
 		v3 = clipInfo.tri->verts[0]; // 1 + 2 is 3 so remainder is 0
-		vl3 = &clipInfo.tri->vertOutputs[0];
+		vl3 = CSMINT_TRI_VARYINGS(clipInfo.tri, 0);
 		break;
 	default:
 		CInternalErrorPopup("Bad clipping state");
@@ -197,23 +185,22 @@ static __forceinline _clipTriCase2(_clipinfo clipInfo, PCIPTriData outTriArray)
 	CVect3F mp1 = _genPlaneIntersectPoint(v3, v1);
 	CVect3F mp2 = _genPlaneIntersectPoint(v3, v2);
 
-	// generate interpolated values
-	CIPVertOutputList vil1 = { 0 }, vil2 = { 0 };
-	_genInterpolatedVertInputs(&vil1, v3, v1, mp1, vl3, vl1);
-	_genInterpolatedVertInputs(&vil2, v3, v2, mp2, vl3, vl2);
+	// generate interpolated values straight into the new triangle
+	PCIPVaryingLayout layout = clipInfo.tri->varyings;
+	outTris[0]->varyings = layout;
+	_genInterpolatedVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 0), v3, v1, mp1, vl3, vl1);
+	_genInterpolatedVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 2), v3, v2, mp2, vl3, vl2);
 
 	// generate final triangle
-	outTriArray[0].verts[0] = mp1;
-	outTriArray[0].verts[1] = v3;
-	outTriArray[0].verts[2] = mp2;
-	_perpareTriWValues(outTriArray + 0);
-
-	outTriArray[0].vertOutputs[0] = vil1;
-	outTriArray[0].vertOutputs[1] = *vl3;
-	outTriArray[0].vertOutputs[2] = vil2;
+	outTris[0]->verts[0] = mp1;
+	outTris[0]->verts[1] = v3;
+	outTris[0]->verts[2] = mp2;
+	_perpareTriWValues(outTris[0]);
+
+	_copyVertInputs(layout, CSMINT_TRI_VARYINGS(outTris[0], 1), vl3);
 }
 
-UINT32 CInternalPipelineClipTri(PCIPTriData inTri, PCIPTriData outTriArray) {
+UINT32 CInternalPipelineClipTri(PCIPTriData inTri, PCIPTriData* outTris) {
 	// note: returns amt of tris generated
 
 	_clipinfo clipInfo = _genTriClipInfo(inTri);
@@ -231,13 +218,13 @@ UINT32 CInternalPipelineClipTri(PCIPTriData inTri, PCIPTriData outTriArray) {
 
 	// if ONLY 1 vert behind
 	if (clipInfo.numBehind == 1) {
-		_clipTriCase1(clipInfo, outTriArray);
+		_clipTriCase1(clipInfo, outTris);
 		return 2; // 2 tris generated
 	}
 
 	// if 2 verts behind
 	if (clipInfo.numBehind == 2) {
-		_clipTriCase2(clipInfo, outTriArray);
+		_clipTriCase2(clipInfo, outTris);
 		return 1; // 1 tri generated
 	}
 
@@ -4,25 +4,299 @@
 
 #include "csmint_pipeline.h"
 
+PCIPVertCache CInternalPipelineMakeVertCache(PCIArena arena, PCRenderClass rClass) {
+	PCMesh mesh = rClass->mesh;
+	PCIPVertCache cache = CInternalArenaAlloc(arena, sizeof(CIPVertCache));
+	ZERO_BYTES(cache, sizeof(CIPVertCache));
+	cache->arena = arena;
+	cache->rClass = rClass;
+	cache->vertCount = mesh->vertCount;
+	return cache;
+}
+
+UINT32 CInternalPipelineResolveMaterialSlot(PCRenderClass rClass, UINT32 triangleID) {
+	if (rClass->singleMaterial == TRUE)
+		return 0;
+
+	// use default material (0) on bad or empty slot
+	UINT32 slot = rClass->triMaterials[triangleID];
+	if (slot >= CSM_CLASS_MAX_MATERIALS || rClass->materials[slot] == NULL)
+		return 0;
+
+	return slot;
+}
+
+static __forceinline PCIPVertCacheEntry _getSlotEntries(PCIPVertCache cache, UINT32 slot) {
+	// make entries for this material slot on first use
+	if (cache->slots[slot] == NULL) {
+		cache->slots[slot] = CInternalArenaAlloc(cache->arena,
+			sizeof(CIPVertCacheEntry) * cache->vertCount);
+
+		// arena memory is not zeroed, entries start unshaded without storage
+		ZERO_BYTES(cache->slots[slot], sizeof(CIPVertCacheEntry) * cache->vertCount);
+	}
+
+	return cache->slots[slot];
+}
+
+// componentCounts holds the component count of every output, 0 when not written
+static PCIPVaryingLayout _internVaryingLayout(PCIPVertCache cache, const UINT32* componentCounts) {
+	// reuse matching layout, draws usually only have one or two
+	for (PCIPVaryingLayout layout = cache->layouts; layout != NULL; layout = layout->next) {
+		if (memcmp(layout->componentCounts, componentCounts, sizeof(UINT32) * CSM_MAX_VERTEX_OUTPUTS) == 0)
+			return layout;
+	}
+
+	// make new packed layout
+	PCIPVaryingLayout layout = CInternalArenaAlloc(cache->arena, sizeof(CIPVaryingLayout));
+	ZERO_BYTES(layout, sizeof(CIPVaryingLayout));
+	for (UINT32 outputID = 0; outputID < CSM_MAX_VERTEX_OUTPUTS; outputID++) {
+		if (componentCounts[outputID] == 0) continue;
+
+		layout->outputIDs[layout->count] = outputID;
+		layout->componentCounts[outputID] = componentCounts[outputID];
+		layout->offsets[outputID] = layout->floatCount;
+		layout->floatCount += componentCounts[outputID];
+		layout->count++;
+	}
+
+	layout->next = cache->layouts;
+	cache->layouts = layout;
+	return layout;
+}
+
+static __forceinline void _packVertOutputs(PCIPVaryingLayout layout,
+	PCIPVertOutputList src, PFLOAT dest) {
+	// only copy values of live outputs
+	for (UINT32 varying = 0; varying < layout->count; varying++) {
+		UINT32 outputID = layout->outputIDs[varying];
+		COPY_BYTES(src->outputs[outputID].valueBuffer, dest + layout->offsets[outputID],
+			sizeof(FLOAT) * layout->componentCounts[outputID]);
+	}
+}
+
+static __forceinline void _reserveEntryValues(PCIPVertCache cache, PCIPVertCacheEntry entry,
+	UINT32 floatCount) {
+	// note: outgrown storage stays in the arena until the draw ends
+	if (entry->capacity >= floatCount) return;
+	entry->values	= CInternalArenaAlloc(cache->arena, sizeof(FLOAT) * floatCount);
+	entry->capacity = floatCount;
+}
+
+static __forceinline void _gatherVertOutputs(PCIPVaryingLayout triLayout, PCIPVertCacheEntry entry,
+	PFLOAT dest) {
+	if (entry->layout == triLayout) {
+		COPY_BYTES(entry->values, dest, sizeof(FLOAT) * triLayout->floatCount);
+		return;
+	}
+
+	// vertex wrote other outputs than the first vertex, components it didn't write read as 0
+	PCIPVaryingLayout vertLayout = entry->layout;
+	for (UINT32 varying = 0; varying < triLayout->count; varying++) {
+		UINT32 outputID	  = triLayout->outputIDs[varying];
+		UINT32 components = triLayout->componentCounts[outputID];
+		UINT32 written	  = min(components, vertLayout->componentCounts[outputID]);
+		PFLOAT pDest	  = dest + triLayout->offsets[outputID];
+
+		COPY_BYTES(entry->values + vertLayout->offsets[outputID], pDest, sizeof(FLOAT) * written);
+		for (UINT32 comp = written; comp < components; comp++)
+			pDest[comp] = 0.0f;
+	}
+}
+
+static PFLOAT _allocBatchArray(PCIArena arena) {
+	return CInternalArenaAlloc(arena, sizeof(FLOAT) * CSM_VERTEX_BATCH_SIZE);
+}
+
+static PCVertexBatch _getVertexBatch(PCIPVertCache cache) {
+	if (cache->batch != NULL)
+		return cache->batch;
+
+	PCIArena arena = cache->arena;
+	PCVertexBatch batch = CInternalArenaAlloc(arena, sizeof(CVertexBatch));
+	ZERO_BYTES(batch, sizeof(CVertexBatch));
+
+	batch->vertexIDs = CInternalArenaAlloc(arena, sizeof(UINT32) * CSM_VERTEX_BATCH_SIZE);
+	for (UINT32 axis = 0; axis < 3; axis++) {
+		batch->inPositions[axis]  = _allocBatchArray(arena);
+		batch->outPositions[axis] = _allocBatchArray(arena);
+	}
+
+	// only bound vertex data streams get input arrays
+	for (UINT32 streamID = 0; streamID < CSM_CLASS_MAX_VERTEX_DATA; streamID++) {
+		PCVertexDataBuffer vdb = cache->rClass->vertexBuffers[streamID];
+		if (vdb == NULL) continue;
+
+		batch->inVertexDataComponents[streamID] = vdb->elementComponents;
+		for (UINT32 comp = 0; comp < vdb->elementComponents; comp++)
+			batch->inVertexData[streamID][comp] = _allocBatchArray(arena);
+	}
+
+	for (UINT32 outputID = 0; outputID < CSM_MAX_VERTEX_OUTPUTS; outputID++) {
+		for (UINT32 comp = 0; comp < CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS; comp++)
+			batch->outputs[outputID][comp] = _allocBatchArray(arena);
+	}
+
+	cache->batch = batch;
+	return batch;
+}
+
+static void _buildSlotVerts(PCIPVertCache cache, UINT32 slot) {
+	PCMesh mesh = cache->rClass->mesh;
+	PBYTE  seen = CInternalArenaAlloc(cache->arena, cache->vertCount);
+	ZERO_BYTES(seen, cache->vertCount);
+
+	PUINT32 verts = CInternalArenaAlloc(cache->arena, sizeof(UINT32) * cache->vertCount);
+	UINT32  count = 0;
+
+	// collect each vertex referenced by a triangle of this slot once
+	for (UINT32 triangleID = 0; triangleID < mesh->triCount; triangleID++) {
+		if (CInternalPipelineResolveMaterialSlot(cache->rClass, triangleID) != slot)
+			continue;
+
+		for (UINT32 triVertexIndex = 0; triVertexIndex < 3; triVertexIndex++) {
+			UINT32 vertexID = mesh->indexArray[(triangleID * 3) + triVertexIndex];
+			if (seen[vertexID]) continue;
+			seen[vertexID] = TRUE;
+			verts[count++] = vertexID;
+		}
+	}
+
+	cache->slotVerts[slot] = verts;
+	cache->slotVertCounts[slot] = count;
+}
+
+static void _shadeSlotBatched(PCIPTriContext triContext, PCIPVertCacheEntry entries, UINT32 stamp) {
+	PCIPVertCache cache = triContext->vertCache;
+	PCRenderClass rClass = cache->rClass;
+	PCMesh mesh = rClass->mesh;
+	UINT32 slot = triContext->materialSlot;
+
+	if (cache->slotVerts[slot] == NULL)
+		_buildSlotVerts(cache, slot);
+
+	PCVertexBatch batch = _getVertexBatch(cache);
+	batch->instanceID = triContext->instanceID;
+
+	// per-vertex accessors are unavailable while a batch is being shaded
+	triContext->vertOutputs = NULL;
+
+	PUINT32 slotVerts = cache->slotVerts[slot];
+	UINT32  slotVertCount = cache->slotVertCounts[slot];
+	for (UINT32 first = 0; first < slotVertCount; first += CSM_VERTEX_BATCH_SIZE) {
+		batch->count = min(CSM_VERTEX_BATCH_SIZE, slotVertCount - first);
+
+		// gather inputs into structure-of-arrays form
+		for (UINT32 i = 0; i < batch->count; i++) {
+			UINT32 vertexID = slotVerts[first + i];
+			CVect3F position = mesh->vertArray[vertexID];
+			batch->vertexIDs[i] = vertexID;
+			batch->inPositions[0][i] = position.x;
+			batch->inPositions[1][i] = position.y;
+			batch->inPositions[2][i] = position.z;
+		}
+
+		for (UINT32 streamID = 0; streamID < CSM_CLASS_MAX_VERTEX_DATA; streamID++) {
+			UINT32 components = batch->inVertexDataComponents[streamID];
+			if (components == 0) continue;
+
+			PCVertexStream stream = triContext->vertexStreams + streamID;
+			for (UINT32 i = 0; i < batch->count; i++) {
+				const FLOAT* element = stream->data + (stream->stride * batch->vertexIDs[i]);
+				for (UINT32 comp = 0; comp < components; comp++)
+					batch->inVertexData[streamID][comp][i] = element[comp];
+			}
+		}
+
+		// mark all vertex outputs as unwritten
+		ZERO_BYTES(batch->outputComponents, sizeof(batch->outputComponents));
+
+		triContext->material->vertexBatchShader(triContext, batch);
+
+		// every vertex of a batch has the same outputs
+		UINT32 componentCounts[CSM_MAX_VERTEX_OUTPUTS];
+		for (UINT32 outputID = 0; outputID < CSM_MAX_VERTEX_OUTPUTS; outputID++)
+			componentCounts[outputID] =
+				min(batch->outputComponents[outputID], CSM_VERTEX_DATA_BUFFER_MAX_COMPONENTS);
+		PCIPVaryingLayout layout = _internVaryingLayout(cache, componentCounts);
+
+		// scatter results into the cache, packed
+		for (UINT32 i = 0; i < batch->count; i++) {
+			PCIPVertCacheEntry entry = entries + batch->vertexIDs[i];
+			entry->position.x = batch->outPositions[0][i];
+			entry->position.y = batch->outPositions[1][i];
+			entry->position.z = batch->outPositions[2][i];
+
+			_reserveEntryValues(cache, entry, layout->floatCount);
+			for (UINT32 varying = 0; varying < layout->count; varying++) {
+				UINT32 outputID = layout->outputIDs[varying];
+				PFLOAT pDest	= entry->values + layout->offsets[outputID];
+				for (UINT32 comp = 0; comp < layout->componentCounts[outputID]; comp++)
+					pDest[comp] = batch->outputs[outputID][comp][i];
+			}
+
+			entry->layout = layout;
+			entry->stamp  = stamp;
+		}
+	}
+}
+
 void CInternalPipelineProcessTri(PCIPTriContext triContext, PCIPTriData inTri) {
+	PCMesh mesh = triContext->rClass->mesh;
+	PCIPVertCache cache = triContext->vertCache;
+	PCIPVertCacheEntry entries = _getSlotEntries(cache, triContext->materialSlot);
+	const UINT32 stamp = triContext->instanceID + 1;
+
 	// loop each vertex
+	PCIPVertCacheEntry triEntries[3];
+	for (UINT32 triVertexIndex = 0; triVertexIndex < 3; triVertexIndex++) {
+		UINT32 vertexID = mesh->indexArray[(triContext->triangleID * 3) + triVertexIndex];
+		PCIPVertCacheEntry entry = entries + vertexID;
+
+		// batched materials shade every vertex of the slot at once on first miss
+		if (entry->stamp != stamp && triContext->material->vertexBatchShader != NULL)
+			_shadeSlotBatched(triContext, entries, stamp);
+
+		// each vertex is only shaded once per instance, shared vertices reuse the cache
+		// note: triangleID and triVertexID given to the shader are from the first triangle
+		// that referenced the vertex
+		if (entry->stamp != stamp) {
+			triContext->vertexID	= vertexID;
+			triContext->triVertexID = triVertexIndex;
+			triContext->vertOutputs = &cache->shaded;
+
+			// mark all vertex outputs as unwritten
+			for (UINT32 outputID = 0; outputID < CSM_MAX_VERTEX_OUTPUTS; outputID++)
+				cache->shaded.outputs[outputID].componentCount = 0;
+
+			// calculate new vertex position and vertex outputs
+			entry->position = triContext->material->vertexShader(
+				triContext,
+				vertexID,
+				triContext->triangleID,
+				triContext->instanceID,
+				mesh->vertArray[vertexID]
+			);
+
+			// keep only the written outputs, packed
+			UINT32 componentCounts[CSM_MAX_VERTEX_OUTPUTS];
+			for (UINT32 outputID = 0; outputID < CSM_MAX_VERTEX_OUTPUTS; outputID++)
+				componentCounts[outputID] = cache->shaded.outputs[outputID].componentCount;
+			entry->layout = _internVaryingLayout(cache, componentCounts);
+
+			_reserveEntryValues(cache, entry, entry->layout->floatCount);
+			_packVertOutputs(entry->layout, &cache->shaded, entry->values);
+			entry->stamp = stamp;
+		}
+
+		triEntries[triVertexIndex] = entry;
+	}
+
+	// assemble triangle from cache, packing outputs by the first vertex's layout
+	inTri->varyings = triEntries[0]->layout;
 	for (UINT32 triVertexIndex = 0; triVertexIndex < 3; triVertexIndex++) {
-		
-		// calculate vertex ID and trivertex ID
-		PCMesh mesh = triContext->rClass->mesh;
-		triContext->vertexID = mesh->indexArray[(triContext->triangleID * 3) + triVertexIndex];
-		triContext->triVertexID = triVertexIndex;
-
-		// calculate new vertex position and vertex outputs
-		CVect3F vertOut = triContext->material->vertexShader(
-			triContext,
-			triContext->vertexID,
-			triContext->triangleID,
-			triContext->instanceID,
-			inTri->verts[triVertexIndex]
-		);
-
-		// update triangle verticies
-		inTri->verts[triVertexIndex] = vertOut;
-	}
-}
\ No newline at end of file
+		inTri->verts[triVertexIndex] = triEntries[triVertexIndex]->position;
+		_gatherVertOutputs(inTri->varyings, triEntries[triVertexIndex],
+			CSMINT_TRI_VARYINGS(inTri, triVertexIndex));
+	}
+}
@@ -14,19 +14,16 @@ static __forceinline FLOAT _fltInv(FLOAT flt) {
 	return rf;
 }
 
-static __forceinline void _drawFragment(PCIPTriContext triContext) {
+// note: depth is left untouched when it was already written or tested for equality
+static __forceinline void _drawFragment(PCIPTriContext triContext, BOOL writeDepth) {
 	PCRenderBuffer renderBuffer = triContext->renderBuffer;
 	// generate frag position
 	INT fragPosX = triContext->fragContext.fragPos.x;
 	INT fragPosY = triContext->fragContext.fragPos.y;
 
-	// get below color
-	CColor belowColor;
-	FLOAT  unusedDepth;
-	CRenderBufferUnsafeGetFragment(renderBuffer, fragPosX, fragPosY, &belowColor, &unusedDepth);
-
 	// prepare rasterization color
 	CColor fragColor = CMakeColor4(0, 0, 0, 0);
+	triContext->fragContext.outputIsFloat = FALSE;
 	if (triContext->material != NULL) {
 		// apply fragment shader
 		BOOL keepFrag = triContext->material->fragmentShader(
@@ -44,61 +41,29 @@ static __forceinline void _drawFragment(PCIPTriContext triContext) {
 		fragColor = CMakeColor3(255, 0, 255);
 	}
 
+	// float output skips the round trip through CColor
+	if (triContext->fragContext.outputIsFloat) {
+		if (triContext->fragContext.outputFloat.w <= 0.0f) return;
+		if (writeDepth && CInternalRenderBufferWriteDepth(renderBuffer, fragPosX, fragPosY,
+			triContext->fragContext.fragPos.depth) == FALSE) return;
+
+		CInternalRenderBufferWriteColorFloat(renderBuffer, fragPosX, fragPosY,
+			triContext->fragContext.outputFloat);
+		return;
+	}
+
 	// if color alpha is 0, cull
 	if (fragColor.a == 0) return;
 
-	// apply alpha blend (if needed)
-	if (fragColor.a != 255)
-		fragColor = CFragmentBlendColor(belowColor, fragColor);
-
 	// apply fragment to renderBuffer
-	CRenderBufferUnsafeSetFragment(
-		renderBuffer,
-		fragPosX,
-		fragPosY,
-		fragColor,
-		triContext->fragContext.fragPos.depth
-	);
-}
+	if (writeDepth && CInternalRenderBufferWriteDepth(renderBuffer, fragPosX, fragPosY,
+		triContext->fragContext.fragPos.depth) == FALSE) return;
 
-static __forceinline void _swapVerts(PCVect3F v1, PCVect3F v2) {
-	CVect3F temp = *v1;
-	*v1 = *v2;
-	*v2 = temp;
-}
-
-static __forceinline void _swapDepths(PFLOAT d1, PFLOAT d2) {
-	FLOAT temp = *d1;
-	*d1 = *d2;
-	*d2 = temp;
-}
-
-static __forceinline void _swapInputLists(PCIPVertOutputList vil1, PCIPVertOutputList vil2) {
-	CIPVertOutputList temp = *vil1;
-	*vil1 = *vil2;
-	*vil2 = temp;
-}
-
-static __forceinline void _sortTriByVerticality(PCIPTriData toEdit) {
-	// brute force sort
-	// set is only 3 large so performance impact is minimal
-	if (toEdit->verts[0].y < toEdit->verts[1].y) {
-		_swapVerts(toEdit->verts + 0, toEdit->verts + 1);
-		_swapDepths(toEdit->invDepths + 0, toEdit->invDepths + 1);
-		_swapInputLists(toEdit->vertOutputs + 0, toEdit->vertOutputs + 1);
-	}
-	
-	if (toEdit->verts[0].y < toEdit->verts[2].y) {
-		_swapVerts(toEdit->verts + 0, toEdit->verts + 2);
-		_swapDepths(toEdit->invDepths + 0, toEdit->invDepths + 2);
-		_swapInputLists(toEdit->vertOutputs + 0, toEdit->vertOutputs + 2);
-	}
-
-	if (toEdit->verts[1].y < toEdit->verts[2].y) {
-		_swapVerts(toEdit->verts + 1, toEdit->verts + 2);
-		_swapDepths(toEdit->invDepths + 1, toEdit->invDepths + 2);
-		_swapInputLists(toEdit->vertOutputs + 1, toEdit->vertOutputs + 2);
-	}
+	// apply alpha blend (if needed)
+	if (fragColor.a != 255)
+		CInternalRenderBufferBlendColor(renderBuffer, fragPosX, fragPosY, fragColor);
+	else
+		CInternalRenderBufferWriteColor(renderBuffer, fragPosX, fragPosY, fragColor);
 }
 
 // note: z is ignored for p1 & p2
@@ -139,217 +104,316 @@ CVect3F CInternalPipelineGenerateBarycentricWeights(PCIPTriData tri, CVect3F ver
 	return _generateBarycentricWeights(tri, vert);
 }
 
-// note: pos.z is ignored
-static __forceinline FLOAT _interpolateDepth(CVect3F weights, PCIPTriData triangle) {
-	weights.x *= (triangle->invDepths[0]);
-	weights.y *= (triangle->invDepths[1]);
-	weights.z *= (triangle->invDepths[2]);
-
-	return _fltInv(weights.x + weights.y + weights.z);
-}
-
-static __forceinline void _prepareFragmentInputValues(PCIPVertOutputList inOutVertList, 
-	PCIPTriData triData, CVect3F bWeights) {
-	PCIPVertOutputList fragInputList1 = &triData->vertOutputs[0];
-	PCIPVertOutputList fragInputList2 = &triData->vertOutputs[1];
-	PCIPVertOutputList fragInputList3 = &triData->vertOutputs[2];
-
-	// interpolate all input values based on fragment
-	for (UINT32 inputID = 0; inputID < CSM_CLASS_MAX_VERTEX_DATA; inputID++) {
-		// get frag inputs
-		PCIPVertOutput vertOutput1 = fragInputList1->outputs + inputID;
-		PCIPVertOutput vertOutput2 = fragInputList2->outputs + inputID;
-		PCIPVertOutput vertOutput3 = fragInputList3->outputs + inputID;
-		PCIPVertOutput outVertOutput = inOutVertList->outputs + inputID;
-
-		// if componentcount is 0, skip
-		if (vertOutput1->componentCount == 0) continue;
-
-		// loop each component and interpolate
-		for (UINT32 comp = 0; comp < vertOutput1->componentCount; comp++) {
-			// get each value for verts
-			FLOAT val1 = vertOutput1->valueBuffer[comp];
-			FLOAT val2 = vertOutput2->valueBuffer[comp];
-			FLOAT val3 = vertOutput3->valueBuffer[comp];
-
-			// get W of each vert multiplied by barycentric weights
-			FLOAT w1 = (triData->invDepths[0]) * bWeights.x;
-			FLOAT w2 = (triData->invDepths[1]) * bWeights.y;
-			FLOAT w3 = (triData->invDepths[2]) * bWeights.z;
-
-			// generate perspective correct values
-			// implementation is taken from:
-			// https://stackoverflow.com/questions/24441631/how-exactly-does-opengl-do-perspectively-correct-linear-interpolation
-			FLOAT finalVal =
-				(val1 * w1 + val2 * w2 + val3 * w3) / (w1 + w2 + w3);
-
-			// assign
-			outVertOutput->valueBuffer[comp] = finalVal;
-			outVertOutput->componentCount = vertOutput1->componentCount;
-		}
+static __forceinline void _prepareFragmentInputValues(PFLOAT outValues, 
+	PCIPTriData triData, CVect3F perspWeights) {
+	PFLOAT fragInputs1 = CSMINT_TRI_VARYINGS(triData, 0);
+	PFLOAT fragInputs2 = CSMINT_TRI_VARYINGS(triData, 1);
+	PFLOAT fragInputs3 = CSMINT_TRI_VARYINGS(triData, 2);
+
+	// interpolate all live input values based on fragment, they are packed
+	// note: weights are already perspective correct, see the span kernels
+	// implementation is taken from:
+	// https://stackoverflow.com/questions/24441631/how-exactly-does-opengl-do-perspectively-correct-linear-interpolation
+	for (UINT32 value = 0; value < triData->varyings->floatCount; value++) {
+		outValues[value] =
+			fragInputs1[value] * perspWeights.x +
+			fragInputs2[value] * perspWeights.y +
+			fragInputs3[value] * perspWeights.z;
 	}
 }
 
-static __forceinline void _prepareAndDrawFragment(PCIPTriContext triContext, INT drawX, INT drawY) {
-	// create fragment with interpolated depth
-	CVect3F drawVect =
-		CMakeVect3F(drawX, drawY, 0.0f);
-	CVect3F bWeights =
-		_generateBarycentricWeights(triContext->screenTriAndData, drawVect);
-	drawVect.z = _interpolateDepth(bWeights, triContext->screenTriAndData);
+static __forceinline BOOL _setupEdges(PCIPTriData tri, PCIPEdgeSetup edges) {
+	CVect3F p0 = tri->verts[0];
+	CVect3F p1 = tri->verts[1];
+	CVect3F p2 = tri->verts[2];
 
-	// early depth test
-	if (CRenderBufferUnsafeDepthTest(triContext->renderBuffer, drawX, drawY, drawVect.z) == FALSE) return;
+	// twice the signed area, either winding is drawn
+	FLOAT area = (p1.y - p2.y) * (p0.x - p2.x) + (p2.x - p1.x) * (p0.y - p2.y);
 
-	// prepare fragment context
-	PCIPFragContext fContext = &triContext->fragContext;
-	fContext->barycentricWeightings = bWeights;
-	fContext->fragPos.x = drawX;
-	fContext->fragPos.y = drawY;
-	fContext->fragPos.depth = drawVect.z;
+	// cull degenerate and bad triangles
+	if (area == 0.0f || isfinite(area) == FALSE) return FALSE;
+	FLOAT invArea = 1.0f / area;
 
-	_prepareFragmentInputValues(&fContext->fragInputs, triContext->screenTriAndData, bWeights);
+	CVect3F edgeStart[3] = { p1, p2, p0 };
+	CVect3F edgeEnd[3]	 = { p2, p0, p1 };
 
-	// draw fragment
-	_drawFragment(triContext);
-}
+	edges->invWStepX = 0.0f;
+	edges->invWStepY = 0.0f;
+	edges->invWOrigin = 0.0f;
 
-static __forceinline void _drawFlatBottomTri(PCIPTriContext triContext, PCIPTriData subTri) {
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		CVect3F s = edgeStart[edgeID];
+		CVect3F e = edgeEnd[edgeID];
+		edges->stepX[edgeID]  = (s.y - e.y) * invArea;
+		edges->stepY[edgeID]  = (e.x - s.x) * invArea;
+		edges->origin[edgeID] = (s.x * e.y - e.x * s.y) * invArea;
+		edges->invDepths[edgeID] = tri->invDepths[edgeID];
 
-	// generate each position
-	CVect3F top = subTri->verts[0];
-	CVect3F LBase = subTri->verts[1];
-	CVect3F RBase = subTri->verts[2];
+		// weights increase inwards, so exactly one of two triangles sharing an edge owns it
+		edges->owned[edgeID] = edges->stepX[edgeID] > 0.0f ||
+			(edges->stepX[edgeID] == 0.0f && edges->stepY[edgeID] < 0.0f);
 
-	// swap to maintain left if necessary
-	if (LBase.x > RBase.x) {
-		_swapVerts(&LBase, &RBase);
-		_swapDepths(subTri->invDepths + 0, subTri->invDepths + 1);
+		edges->invWStepX  += edges->stepX[edgeID]  * tri->invDepths[edgeID];
+		edges->invWStepY  += edges->stepY[edgeID]  * tri->invDepths[edgeID];
+		edges->invWOrigin += edges->origin[edgeID] * tri->invDepths[edgeID];
 	}
 
-	// generate inverse slopes
-	FLOAT invDY = _fltInv(top.y - LBase.y);
-	FLOAT invSlopeL = (top.x - LBase.x) * invDY;
-	FLOAT invSlopeR = (top.x - RBase.x) * invDY;
-
-	// on bad values, don't draw
-	if (isinf(invSlopeL) || isinf(invSlopeR)) return;
+	return TRUE;
+}
 
-	// walk up from bottom to top
-	PCRenderBuffer renderBuff = triContext->renderBuffer;
+static __forceinline void _shadeFragment(PCIPTriContext triContext, INT drawX, INT drawY,
+	CVect3F weights, CVect3F perspWeights, FLOAT depth, BOOL writeDepth) {
+	// prepare fragment context
+	PCIPFragContext fContext = &triContext->fragContext;
+	fContext->barycentricWeightings = weights;
+	fContext->fragPos.x = drawX;
+	fContext->fragPos.y = drawY;
+	fContext->fragPos.depth = depth;
 
-	const INT DRAW_Y_START = max(0, LBase.y);
-	const INT DRAW_Y_END   = min(renderBuff->height - 1, top.y);
+	_prepareFragmentInputValues(fContext->fragInputs, triContext->screenTriAndData, perspWeights);
 
-	for (INT drawY = DRAW_Y_START; drawY <= DRAW_Y_END; drawY++) {
+	// draw fragment
+	_drawFragment(triContext, writeDepth);
+}
 
-		// get distance travelled from start Y
-		// yDist has the potential to be < 0 due to floating point math, so we clamp it
-		FLOAT yDist = max(0.0f, drawY - LBase.y);
+static __forceinline void _prepareAndDrawFragment(PCIPTriContext triContext, INT drawX, INT drawY,
+	PCIPSpan span, UINT32 lane) {
+	// note: coverage and early depth test are already done by the span kernel
+	FLOAT depth = span->depths[lane];
 
-		// generate start and end X positions
-		const INT DRAW_X_START =
-			max(0, LBase.x + (invSlopeL * yDist));
-		const INT DRAW_X_END =
-			min(renderBuff->width - 1, RBase.x + (invSlopeR * yDist));
+	PCRenderBuffer renderBuffer = triContext->renderBuffer;
+	BOOL writeDepth = (triContext->depthTest == CDepthTest_Greater);
 
-		// walk from left of triangle to right of triangle
-		for (INT drawX = DRAW_X_START; drawX <= DRAW_X_END; drawX++) {
-			// prepare and draw fragment
-			_prepareAndDrawFragment(triContext, drawX, drawY);
-		}
+	// depth only skips interpolation and shading entirely
+	if (triContext->depthOnly) {
+		CInternalRenderBufferWriteDepth(renderBuffer, drawX, drawY, depth);
+		return;
 	}
-}
-
-static __forceinline void _drawFlatTopTri(PCIPTriContext triContext, PCIPTriData subTri) {
-
-	// generate each position
-	CVect3F LBase  = subTri->verts[0];
-	CVect3F RBase  = subTri->verts[1];
-	CVect3F bottom = subTri->verts[2];
 
-	// swap to maintain left if necessary
-	if (LBase.x > RBase.x) {
-		_swapVerts(&LBase, &RBase);
-		_swapDepths(subTri->invDepths + 0, subTri->invDepths + 1);
+	// in visibility buffer mode only depth and the triangle are stored, shading is deferred
+	if (triContext->visBuffer != NULL) {
+		if (writeDepth == FALSE || CInternalRenderBufferWriteDepth(renderBuffer, drawX, drawY, depth))
+			triContext->visBuffer[drawX + (drawY * renderBuffer->width)] = triContext->visRecord;
+		return;
 	}
 
-	// generate inverse slopes
-	FLOAT invDY = _fltInv(bottom.y - LBase.y);
-	FLOAT invSlopeL = (bottom.x - LBase.x) * invDY;
-	FLOAT invSlopeR = (bottom.x - RBase.x) * invDY;
+	CVect3F weights = CMakeVect3F(
+		span->weights[0][lane], span->weights[1][lane], span->weights[2][lane]);
+	CVect3F perspWeights = CMakeVect3F(
+		span->perspWeights[0][lane], span->perspWeights[1][lane], span->perspWeights[2][lane]);
+	_shadeFragment(triContext, drawX, drawY, weights, perspWeights, depth, writeDepth);
+}
 
-	// on bad values, don't draw
-	if (isinf(invSlopeL) || isinf(invSlopeR)) return;
+static __forceinline BOOL _insideEdge(FLOAT weight, BOOL owned) {
+	return (weight > 0.0f) || (weight == 0.0f && owned);
+}
 
-	// walk down from top to bottom
-	PCRenderBuffer renderBuff = triContext->renderBuffer;
+// evaluated exactly as the span kernels do, which keeps it monotonic in x and y
+// so the extremes of any rect of pixels are at its corners
+static __forceinline FLOAT _edgeAt(PCIPEdgeSetup edges, UINT32 edgeID, INT x, INT y) {
+	FLOAT rowBase = edges->origin[edgeID] + edges->stepY[edgeID] * y;
+	return rowBase + edges->stepX[edgeID] * (FLOAT)x;
+}
 
-	// calculate top and bottom
-	const INT DRAW_Y_START = min(renderBuff->height - 1, LBase.y);
-	const INT DRAW_Y_END = max(0, bottom.y);
+static __forceinline BOOL _blockOutsideTri(PCIPEdgeSetup edges, CIPRect block) {
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		FLOAT cornerMax = max(
+			max(_edgeAt(edges, edgeID, block.minX, block.minY), _edgeAt(edges, edgeID, block.maxX, block.minY)),
+			max(_edgeAt(edges, edgeID, block.minX, block.maxY), _edgeAt(edges, edgeID, block.maxX, block.maxY)));
+		if (_insideEdge(cornerMax, edges->owned[edgeID]) == FALSE) return TRUE;
+	}
+	return FALSE;
+}
 
-	// note: Y walks downwards
-	for (INT drawY = DRAW_Y_START; drawY >= DRAW_Y_END; drawY--) {
+void   CInternalPipelineRasterizeTri(PCIPTriContext triContext, PCIPTriData triangle) {
+	
+	// set triContext's triangle to current screen triangle
+	triContext->screenTriAndData = triangle;
 
-		// get distance travelled from start Y
-		FLOAT yDist = LBase.y - drawY;
+	// setup edges once for the whole triangle
+	CIPEdgeSetup edges;
+	if (_setupEdges(triangle, &edges) == FALSE) return;
+
+	// get bounding box of triangle, staying inside the scissor rect
+	// note: pixels are sampled at integer coordinates
+	CVect3F p0 = triangle->verts[0];
+	CVect3F p1 = triangle->verts[1];
+	CVect3F p2 = triangle->verts[2];
+	CIPRect scissor = triContext->scissor;
+
+	FLOAT boundMinX = ceilf(min(p0.x, min(p1.x, p2.x)));
+	FLOAT boundMinY = ceilf(min(p0.y, min(p1.y, p2.y)));
+	FLOAT boundMaxX = floorf(max(p0.x, max(p1.x, p2.x)));
+	FLOAT boundMaxY = floorf(max(p0.y, max(p1.y, p2.y)));
+
+	// cull if entirely outside of the scissor rect
+	if (boundMaxX < scissor.minX || boundMinX > scissor.maxX ||
+		boundMaxY < scissor.minY || boundMinY > scissor.maxY) return;
+
+	const INT DRAW_X_START = max(scissor.minX, (INT)boundMinX);
+	const INT DRAW_X_END   = min(scissor.maxX, (INT)boundMaxX);
+	const INT DRAW_Y_START = max(scissor.minY, (INT)boundMinY);
+	const INT DRAW_Y_END   = min(scissor.maxY, (INT)boundMaxY);
+
+	// depth of the triangle is always between its vertex depths
+	// note: per-pixel depth uses an approximate reciprocal, so bounds are widened
+	FLOAT triNearest  = max(p0.z, max(p1.z, p2.z));
+	FLOAT triFarthest = min(p0.z, min(p1.z, p2.z));
+	FLOAT depthMargin = fabsf(triFarthest) * CSMINT_HIZ_DEPTH_ERROR;
+	triNearest	+= depthMargin;
+	triFarthest -= depthMargin;
+
+	// fragment inputs are packed by the triangle's layout
+	triContext->fragContext.varyings = triangle->varyings;
+	triContext->fragContext.edges	 = &edges;
+	triContext->fragContext.quadX	 = -1;
 
-		// generate start and end X positions
-		const INT DRAW_X_START =
-			max(0, LBase.x - (invSlopeL * yDist));
-		const INT DRAW_X_END =
-			min(renderBuff->width - 1, RBase.x - (invSlopeR * yDist));
+	PCRenderBuffer renderBuffer = triContext->renderBuffer;
+	PCIPSpanKernelProc spanKernel = CInternalPipelineGetSpanKernel();
+	CIPSpan span;
+
+	// walk each coarse depth block the triangle's bounds overlap
+	// note: a block row is exactly one span wide
+	for (INT blockY = DRAW_Y_START / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+		blockY <= DRAW_Y_END / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE; blockY++) {
+		for (INT blockX = DRAW_X_START / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE;
+			blockX <= DRAW_X_END / CSM_RENDERBUFFER_HIZ_BLOCK_SIZE; blockX++) {
+			CIPRect block;
+			block.minX = max(DRAW_X_START, blockX * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+			block.minY = max(DRAW_Y_START, blockY * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE);
+			block.maxX = min(DRAW_X_END, (blockX + 1) * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE - 1);
+			block.maxY = min(DRAW_Y_END, (blockY + 1) * CSM_RENDERBUFFER_HIZ_BLOCK_SIZE - 1);
+
+			// skip blocks the triangle doesn't touch
+			if (_blockOutsideTri(&edges, block)) continue;
+
+			FLOAT  hizMin  = CInternalRenderBufferHiZMin(renderBuffer, blockX, blockY);
+			UINT32 blockID = blockX + (blockY * renderBuffer->hizWidth);
+			BOOL   depthTest = TRUE;
+
+			if (triContext->depthTest == CDepthTest_Equal) {
+				// skip blocks where no stored depth can be matched
+				if (triNearest < hizMin + CSM_RENDERBUFFER_DEPTH_TEST_EPSILON) continue;
+				if (triFarthest > renderBuffer->hizMax[blockID] - CSM_RENDERBUFFER_DEPTH_TEST_EPSILON) continue;
+			}
+			else {
+				// skip blocks where every stored depth is nearer than the triangle
+				if (triNearest <= hizMin) continue;
+
+				// skip per-pixel depth reads when the triangle is nearer than every stored depth
+				depthTest = (triFarthest - renderBuffer->hizMax[blockID]) <
+					-(CSM_RENDERBUFFER_DEPTH_TEST_EPSILON * 2.0f);
+			}
+
+			// fill owed clears before the block's planes are first touched
+			// note: blocks never straddle bins, so only this thread touches it
+			if (renderBuffer->tileClear[blockID] != 0)
+				CInternalRenderBufferResolveTile(renderBuffer, blockID);
+
+			for (INT drawY = block.minY; drawY <= block.maxY; drawY++) {
+				PVOID spanDepths = NULL;
+				if (depthTest)
+					spanDepths = CSMINT_RB_DEPTH_PTR(renderBuffer, block.minX, drawY);
+
+				spanKernel(&edges, block.minX, drawY, block.maxX - block.minX + 1, spanDepths,
+					renderBuffer->depthFormat, triContext->depthTest, &span);
+
+				// only covered pixels that passed the depth test are shaded
+				UINT32 mask = span.mask;
+				while (mask != 0) {
+					ULONG lane;
+					_BitScanForward(&lane, mask);
+					mask &= mask - 1;
+
+					_prepareAndDrawFragment(triContext, block.minX + lane, drawY, &span, lane);
+				}
+			}
+		}
+	}
+}
 
-		// walk from left of triangle to right of triangle
-		for (INT drawX = DRAW_X_START; drawX <= DRAW_X_END; drawX++) {
-			// prepare and draw fragment
-			_prepareAndDrawFragment(triContext, drawX, drawY);
+void   CInternalPipelineResolveVisBuffer(PCIPTriContext triContext) {
+	PCRenderBuffer renderBuffer = triContext->renderBuffer;
+	CIPRect scissor = triContext->scissor;
+
+	// neighbouring pixels usually share a triangle, so setup is only redone on change
+	PCIPTriRecord lastRecord = NULL;
+	PCIPVisDraw	  lastDraw	 = NULL;
+	CIPEdgeSetup  edges;
+
+	for (INT drawY = scissor.minY; drawY <= scissor.maxY; drawY++) {
+		PCIPTriRecord* visRow = triContext->visBuffer + (drawY * renderBuffer->width);
+
+		for (INT drawX = scissor.minX; drawX <= scissor.maxX; drawX++) {
+			PCIPTriRecord record = visRow[drawX];
+			if (record == NULL) continue;
+
+			// empty the visibility buffer for the next resolve
+			visRow[drawX] = NULL;
+
+			// shade with the state of the draw that recorded the triangle
+			if (record->visDraw != lastDraw) {
+				triContext->rClass	   = record->visDraw->rClass;
+				triContext->drawInputs = record->visDraw->drawInputs;
+				COPY_BYTES(record->visDraw->staticData, triContext->staticData,
+					sizeof(triContext->staticData));
+				lastDraw = record->visDraw;
+			}
+
+			if (record != lastRecord) {
+				_setupEdges(record->tri, &edges);
+				triContext->instanceID = record->instanceID;
+				triContext->triangleID = record->triangleID;
+				triContext->material   = record->material;
+				triContext->screenTriAndData	 = record->tri;
+				triContext->fragContext.varyings = record->tri->varyings;
+				triContext->fragContext.edges	 = &edges;
+				triContext->fragContext.quadX	 = -1;
+				lastRecord = record;
+			}
+
+			// reconstruct fragment the same way the span kernels do
+			FLOAT invWBase = edges.invWOrigin + edges.invWStepY * drawY;
+			FLOAT invW	   = invWBase + edges.invWStepX * (FLOAT)drawX;
+			FLOAT w		   = 1.0f / invW;
+
+			CVect3F weights = CMakeVect3F(
+				_edgeAt(&edges, 0, drawX, drawY),
+				_edgeAt(&edges, 1, drawX, drawY),
+				_edgeAt(&edges, 2, drawX, drawY));
+			CVect3F perspWeights = CMakeVect3F(
+				weights.x * edges.invDepths[0] * w,
+				weights.y * edges.invDepths[1] * w,
+				weights.z * edges.invDepths[2] * w);
+
+			_shadeFragment(triContext, drawX, drawY, weights, perspWeights, _fltInv(invW), FALSE);
 		}
 	}
 }
 
-void   CInternalPipelineRasterizeTri(PCIPTriContext triContext, PCIPTriData triangle) {
-	
-	// set triContext's triangle to current screen triangle
-	triContext->screenTriAndData = triangle;
+static __forceinline CVect3F _perspWeightsAt(PCIPEdgeSetup edges, INT x, INT y) {
+	// note: exact reciprocal, derivatives are differences of nearby values
+	FLOAT invWBase = edges->invWOrigin + edges->invWStepY * y;
+	FLOAT w		   = 1.0f / (invWBase + edges->invWStepX * (FLOAT)x);
+	return CMakeVect3F(
+		_edgeAt(edges, 0, x, y) * edges->invDepths[0] * w,
+		_edgeAt(edges, 1, x, y) * edges->invDepths[1] * w,
+		_edgeAt(edges, 2, x, y) * edges->invDepths[2] * w);
+}
 
-	// sort triangle vertically
-	_sortTriByVerticality(triangle);
-
-	// now triangle is:
-	// p0 -> top
-	// p1 -> middle
-	// p2 -> bottom
-
-	// cull if triangle is squashed
-	if ((INT)triangle->verts[0].x == (INT)triangle->verts[1].x &&
-		(INT)triangle->verts[0].x == (INT)triangle->verts[2].x) return;
-
-	// generate point given a horizontal cut of the triangle
-	FLOAT invslope =
-		(triangle->verts[0].x - triangle->verts[2].x) /
-		(triangle->verts[0].y - triangle->verts[2].y);
-	FLOAT horzPointx =
-		triangle->verts[2].x + (invslope * (triangle->verts[1].y - triangle->verts[2].y));
-	CVect3F horzPoint =
-		CMakeVect3F(horzPointx, triangle->verts[1].y, 0);
-
-	// assign depth
-	CVect3F baryWeightings = 
-		_generateBarycentricWeights(triangle, horzPoint);
-	horzPoint.z = 
-		_interpolateDepth(baryWeightings, triangle, horzPoint);
-
-	// make both triangles and draw
-	CIPTriData flatBottomTri;
-	COPY_BYTES(triangle, &flatBottomTri, sizeof(CIPTriData));
-	flatBottomTri.verts[2] = horzPoint; // bottom is now flat
-
-	CIPTriData flatTopTri;
-	COPY_BYTES(triangle, &flatTopTri, sizeof(CIPTriData));
-	flatTopTri.verts[0] = horzPoint; // top is now flat
-
-	_drawFlatBottomTri(triContext, &flatBottomTri);
-	_drawFlatTopTri(triContext, &flatTopTri);
-}
\ No newline at end of file
+void   CInternalPipelineQuadDerivatives(PCIPFragContext fContext) {
+	// every fragment of a quad shares its derivatives, like coarse derivatives on a gpu
+	INT quadX = fContext->fragPos.x & ~1;
+	INT quadY = fContext->fragPos.y & ~1;
+	if (fContext->quadX == quadX && fContext->quadY == quadY) return;
+
+	// weights are evaluated at every pixel of the quad, even uncovered ones
+	CVect3F origin = _perspWeightsAt(fContext->edges, quadX,	 quadY);
+	CVect3F right  = _perspWeightsAt(fContext->edges, quadX + 1, quadY);
+	CVect3F up	   = _perspWeightsAt(fContext->edges, quadX,	 quadY + 1);
+	fContext->quadWeightsDX = CMakeVect3F(right.x - origin.x, right.y - origin.y, right.z - origin.z);
+	fContext->quadWeightsDY = CMakeVect3F(up.x - origin.x, up.y - origin.y, up.z - origin.z);
+
+	fContext->quadX = quadX;
+	fContext->quadY = quadY;
+}
@@ -0,0 +1,217 @@
+// <csmint_pl_spankernel.c>
+// Bailey Jia-Tao Brown
+// 2023
+
+#include "csmint_pipeline.h"
+#include <immintrin.h>
+
+// note: lanes are evaluated directly from their x position instead of being stepped
+// from the span start so that every kernel and every tile layout gives identical results
+
+static __forceinline __m128 _edgeMaskSSE2(__m128 weight, BOOL owned) {
+	__m128 inside = _mm_cmpgt_ps(weight, _mm_setzero_ps());
+	if (owned) inside = _mm_or_ps(inside, _mm_cmpeq_ps(weight, _mm_setzero_ps()));
+	return inside;
+}
+
+// note: matches CRenderBufferUnsafeDepthTest for CDepthTest_Greater
+static __forceinline __m128 _depthPassSSE2(__m128 oldDepth, __m128 newDepth, CDepthTest depthTest) {
+	__m128 diff = _mm_sub_ps(oldDepth, newDepth);
+	if (depthTest == CDepthTest_Equal)
+		return _mm_cmple_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), diff),
+			_mm_set1_ps(-CSM_RENDERBUFFER_DEPTH_TEST_EPSILON));
+	return _mm_cmplt_ps(diff, _mm_set1_ps(CSM_RENDERBUFFER_DEPTH_TEST_EPSILON));
+}
+
+// note: matches CRenderBufferUnsafeDepthTest for 16 bit depth, compared after rounding
+static __forceinline __m128 _depthPass16SSE2(__m128i oldDepth, __m128 newDepth, CDepthTest depthTest) {
+	__m128 scaled = _mm_mul_ps(_mm_sub_ps(newDepth, _mm_set1_ps(CSM_RENDERBUFFER_MAX_DEPTH)),
+		_mm_set1_ps(CSMINT_DEPTH16_SCALE));
+	scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(CSMINT_DEPTH16_MAX));
+	__m128i quantized = _mm_cvtps_epi32(scaled);
+
+	if (depthTest == CDepthTest_Equal)
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(quantized, oldDepth));
+	return _mm_castsi128_ps(_mm_cmpgt_epi32(quantized, oldDepth));
+}
+
+static __forceinline UINT32 _spanQuadSSE2(PCIPEdgeSetup edges, INT x, INT y, UINT32 lane,
+	PVOID oldDepths, CDepthFormat depthFormat, CDepthTest depthTest, PCIPSpan span) {
+	__m128 xLanes = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x + lane),
+		_mm_setr_epi32(0, 1, 2, 3)));
+
+	// coverage
+	__m128 weights[3];
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		FLOAT rowBase = edges->origin[edgeID] + edges->stepY[edgeID] * y;
+		weights[edgeID] = _mm_add_ps(_mm_set1_ps(rowBase),
+			_mm_mul_ps(_mm_set1_ps(edges->stepX[edgeID]), xLanes));
+		inside = _mm_and_ps(inside, _edgeMaskSSE2(weights[edgeID], edges->owned[edgeID]));
+	}
+
+	// skip depth when nothing is covered
+	UINT32 mask = _mm_movemask_ps(inside);
+	if (mask == 0) return 0;
+
+	// perspective correct depth
+	FLOAT  invWBase = edges->invWOrigin + edges->invWStepY * y;
+	__m128 invW	  = _mm_add_ps(_mm_set1_ps(invWBase),
+		_mm_mul_ps(_mm_set1_ps(edges->invWStepX), xLanes));
+	__m128 depths = _mm_rcp_ps(invW);
+
+	// early depth test
+	if (oldDepths != NULL) {
+		__m128 pass;
+		if (depthFormat == CDepthFormat_Unorm16) {
+			__m128i oldDepth = _mm_unpacklo_epi16(
+				_mm_loadl_epi64((__m128i*)((PUINT16)oldDepths + lane)), _mm_setzero_si128());
+			pass = _depthPass16SSE2(oldDepth, depths, depthTest);
+		}
+		else {
+			pass = _depthPassSSE2(_mm_loadu_ps((PFLOAT)oldDepths + lane), depths, depthTest);
+		}
+		mask &= _mm_movemask_ps(pass);
+		if (mask == 0) return 0;
+	}
+
+	// perspective correct weights only for lanes that may be shaded
+	__m128 w = _mm_div_ps(_mm_set1_ps(1.0f), invW);
+	_mm_storeu_ps(span->depths + lane, depths);
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		__m128 persp = _mm_mul_ps(_mm_mul_ps(weights[edgeID],
+			_mm_set1_ps(edges->invDepths[edgeID])), w);
+		_mm_storeu_ps(span->weights[edgeID] + lane, weights[edgeID]);
+		_mm_storeu_ps(span->perspWeights[edgeID] + lane, persp);
+	}
+
+	return mask << lane;
+}
+
+static void _spanKernelSSE2(PCIPEdgeSetup edges, INT x, INT y, UINT32 count,
+	PVOID spanDepths, CDepthFormat depthFormat, CDepthTest depthTest, PCIPSpan span) {
+	// partial spans are copied so that loads never leave the row
+	FLOAT depthCopy[CSMINT_SPAN_WIDTH];
+	PVOID oldDepths = spanDepths;
+	if (oldDepths != NULL && count < CSMINT_SPAN_WIDTH) {
+		COPY_BYTES(oldDepths, depthCopy, CSMINT_DEPTH_BYTES(depthFormat) * count);
+		oldDepths = depthCopy;
+	}
+
+	UINT32 mask = _spanQuadSSE2(edges, x, y, 0, oldDepths, depthFormat, depthTest, span);
+	if (count > 4) mask |= _spanQuadSSE2(edges, x, y, 4, oldDepths, depthFormat, depthTest, span);
+
+	span->mask = mask & ((1 << count) - 1);
+}
+
+static __forceinline __m256 _edgeMaskAVX2(__m256 weight, BOOL owned) {
+	__m256 inside = _mm256_cmp_ps(weight, _mm256_setzero_ps(), _CMP_GT_OQ);
+	if (owned) inside = _mm256_or_ps(inside,
+		_mm256_cmp_ps(weight, _mm256_setzero_ps(), _CMP_EQ_OQ));
+	return inside;
+}
+
+static __forceinline __m256 _depthPassAVX2(__m256 oldDepth, __m256 newDepth, CDepthTest depthTest) {
+	__m256 diff = _mm256_sub_ps(oldDepth, newDepth);
+	if (depthTest == CDepthTest_Equal)
+		return _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), diff),
+			_mm256_set1_ps(-CSM_RENDERBUFFER_DEPTH_TEST_EPSILON), _CMP_LE_OQ);
+	return _mm256_cmp_ps(diff, _mm256_set1_ps(CSM_RENDERBUFFER_DEPTH_TEST_EPSILON), _CMP_LT_OQ);
+}
+
+static __forceinline __m256 _depthPass16AVX2(__m256i oldDepth, __m256 newDepth, CDepthTest depthTest) {
+	__m256 scaled = _mm256_mul_ps(_mm256_sub_ps(newDepth, _mm256_set1_ps(CSM_RENDERBUFFER_MAX_DEPTH)),
+		_mm256_set1_ps(CSMINT_DEPTH16_SCALE));
+	scaled = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(CSMINT_DEPTH16_MAX));
+	__m256i quantized = _mm256_cvtps_epi32(scaled);
+
+	if (depthTest == CDepthTest_Equal)
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(quantized, oldDepth));
+	return _mm256_castsi256_ps(_mm256_cmpgt_epi32(quantized, oldDepth));
+}
+
+static void _spanKernelAVX2(PCIPEdgeSetup edges, INT x, INT y, UINT32 count,
+	PVOID spanDepths, CDepthFormat depthFormat, CDepthTest depthTest, PCIPSpan span) {
+	__m256i lanes  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256	xLanes = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), lanes));
+
+	// coverage
+	__m256 weights[3];
+	__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		FLOAT rowBase = edges->origin[edgeID] + edges->stepY[edgeID] * y;
+		weights[edgeID] = _mm256_add_ps(_mm256_set1_ps(rowBase),
+			_mm256_mul_ps(_mm256_set1_ps(edges->stepX[edgeID]), xLanes));
+		inside = _mm256_and_ps(inside, _edgeMaskAVX2(weights[edgeID], edges->owned[edgeID]));
+	}
+
+	// skip depth when nothing is covered
+	UINT32 mask = _mm256_movemask_ps(inside) & ((1 << count) - 1);
+	if (mask == 0) {
+		span->mask = 0;
+		return;
+	}
+
+	// perspective correct depth
+	FLOAT  invWBase = edges->invWOrigin + edges->invWStepY * y;
+	__m256 invW	  = _mm256_add_ps(_mm256_set1_ps(invWBase),
+		_mm256_mul_ps(_mm256_set1_ps(edges->invWStepX), xLanes));
+	__m256 depths = _mm256_rcp_ps(invW);
+
+	// early depth test, loads never leave the row
+	if (spanDepths != NULL && depthFormat == CDepthFormat_Unorm16) {
+		UINT16 depthCopy[CSMINT_SPAN_WIDTH];
+		PUINT16 oldDepths = spanDepths;
+		if (count < CSMINT_SPAN_WIDTH) {
+			COPY_BYTES(oldDepths, depthCopy, sizeof(UINT16) * count);
+			oldDepths = depthCopy;
+		}
+
+		__m256i oldDepth = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i*)oldDepths));
+		mask &= _mm256_movemask_ps(_depthPass16AVX2(oldDepth, depths, depthTest));
+	}
+	else if (spanDepths != NULL) {
+		__m256i loadMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count), lanes);
+		__m256	oldDepth = _mm256_maskload_ps(spanDepths, loadMask);
+		mask &= _mm256_movemask_ps(_depthPassAVX2(oldDepth, depths, depthTest));
+	}
+
+	span->mask = mask;
+	if (mask == 0) return;
+
+	// perspective correct weights only for lanes that may be shaded
+	__m256 w = _mm256_div_ps(_mm256_set1_ps(1.0f), invW);
+	_mm256_storeu_ps(span->depths, depths);
+	for (UINT32 edgeID = 0; edgeID < 3; edgeID++) {
+		__m256 persp = _mm256_mul_ps(_mm256_mul_ps(weights[edgeID],
+			_mm256_set1_ps(edges->invDepths[edgeID])), w);
+		_mm256_storeu_ps(span->weights[edgeID], weights[edgeID]);
+		_mm256_storeu_ps(span->perspWeights[edgeID], persp);
+	}
+}
+
+static BOOL _cpuHasAVX2(void) {
+	INT info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return FALSE;
+
+	// AVX must be usable, which requires the OS to save YMM registers
+	__cpuid(info, 1);
+	BOOL hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	BOOL hasAVX		= (info[2] & (1 << 28)) != 0;
+	if (hasOSXSAVE == FALSE || hasAVX == FALSE) return FALSE;
+	if ((_xgetbv(0) & 0x6) != 0x6) return FALSE;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+PCIPSpanKernelProc CInternalPipelineGetSpanKernel(void) {
+	// note: racing first calls all store the same value
+	static volatile PCIPSpanKernelProc kernel = NULL;
+
+	if (kernel == NULL)
+		kernel = _cpuHasAVX2() ? _spanKernelAVX2 : _spanKernelSSE2;
+
+	return kernel;
+}
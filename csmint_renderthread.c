@@ -0,0 +1,105 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_renderthread.c>
+
+#include "csmint_renderthread.h"
+
+static void _runJob(PCIRenderJob job) {
+	// get start tick
+	LARGE_INTEGER counterStartTick;
+	QueryPerformanceCounter(&counterStartTick);
+
+	PCDrawContext context = job->drawContext;
+	CInternalDrawInstanced(context, job->rClass, job->instanceCount, job->inputs);
+
+	// get end tick and convert to MS
+	LARGE_INTEGER counterEndTick;
+	QueryPerformanceCounter(&counterEndTick);
+
+	CInternalGlobalLock();
+	LONGLONG counterTicksElapsed = counterEndTick.QuadPart - counterStartTick.QuadPart;
+	context->lastDrawTimeMS = (UINT64)(counterTicksElapsed / _csmint.perfCounterHzMs.QuadPart);
+
+	InterlockedDecrement(&context->asyncPending);
+
+	// free captured inputs and job
+	PCFence fence = job->fence;
+	for (UINT32 inputID = 0; inputID < CSM_MAX_DRAW_INPUTS; inputID++) {
+		if (job->inputs[inputID].pData != NULL)
+			CInternalFree(job->inputs[inputID].pData);
+	}
+	CInternalFree(job);
+
+	CInternalGlobalUnlock();
+
+	// signal fence
+	InterlockedExchange(&fence->signaled, TRUE);
+	SetEvent(fence->signalEvent);
+}
+
+static DWORD WINAPI _renderThreadProc(LPVOID param) {
+	PCIRenderThread renderThread = param;
+
+	while (TRUE) {
+		WaitForSingleObject(renderThread->jobSemaphore, INFINITE);
+
+		// take the oldest job
+		EnterCriticalSection(&renderThread->queueLock);
+		PCIRenderJob job = renderThread->firstJob;
+		if (job != NULL) {
+			renderThread->firstJob = job->next;
+			if (renderThread->firstJob == NULL)
+				renderThread->lastJob = NULL;
+		}
+		LeaveCriticalSection(&renderThread->queueLock);
+
+		// the shutdown release comes after every job, so an empty queue means exit
+		if (job == NULL) return ZERO;
+
+		_runJob(job);
+	}
+}
+
+static PCIRenderThread _getRenderThread(void) {
+	// lazily make render thread on first use
+	if (_csmint.renderThread != NULL) return _csmint.renderThread;
+
+	PCIRenderThread renderThread = CInternalAlloc(sizeof(CIRenderThread));
+	InitializeCriticalSection(&renderThread->queueLock);
+	renderThread->jobSemaphore = CreateSemaphoreA(NULL, ZERO, MAXLONG, NULL);
+	renderThread->thread = CreateThread(NULL, ZERO, _renderThreadProc, renderThread, ZERO, NULL);
+
+	_csmint.renderThread = renderThread;
+	return renderThread;
+}
+
+void CInternalRenderThreadQueue(PCIRenderJob job) {
+	PCIRenderThread renderThread = _getRenderThread();
+
+	InterlockedIncrement(&job->drawContext->asyncPending);
+
+	EnterCriticalSection(&renderThread->queueLock);
+	job->next = NULL;
+	if (renderThread->lastJob == NULL)
+		renderThread->firstJob = job;
+	else
+		renderThread->lastJob->next = job;
+	renderThread->lastJob = job;
+	LeaveCriticalSection(&renderThread->queueLock);
+
+	ReleaseSemaphore(renderThread->jobSemaphore, 1, NULL);
+}
+
+void CInternalRenderThreadShutdown(void) {
+	PCIRenderThread renderThread = _csmint.renderThread;
+	if (renderThread == NULL) return;
+
+	// note: called without the global lock, queued jobs need it to finish
+	ReleaseSemaphore(renderThread->jobSemaphore, 1, NULL);
+	WaitForSingleObject(renderThread->thread, INFINITE);
+	CloseHandle(renderThread->thread);
+	CloseHandle(renderThread->jobSemaphore);
+	DeleteCriticalSection(&renderThread->queueLock);
+	CInternalFree(renderThread);
+	_csmint.renderThread = NULL;
+}
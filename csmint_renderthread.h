@@ -0,0 +1,34 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_renderthread.h>
+
+#ifndef _CSMINT_RENDERTHREAD_INCLUDE_
+#define _CSMINT_RENDERTHREAD_INCLUDE_
+
+#include "csmint.h"
+#include "csm_draw.h"
+
+// draw queued for the render thread
+// note: inputs are copies owned by the job, freed once it has run
+typedef struct CIRenderJob {
+	struct CIRenderJob* next;
+	PCDrawContext		drawContext;
+	PCRenderClass		rClass;
+	UINT32				instanceCount;
+	CDrawInput			inputs[CSM_MAX_DRAW_INPUTS];
+	PCFence				fence;
+} CIRenderJob, *PCIRenderJob;
+
+typedef struct CIRenderThread {
+	HANDLE			 thread;
+	HANDLE			 jobSemaphore; // released once per job and once on shutdown
+	CRITICAL_SECTION queueLock;
+	PCIRenderJob	 firstJob;
+	PCIRenderJob	 lastJob;
+} CIRenderThread, *PCIRenderThread;
+
+// note: must be called with the global lock held
+void CInternalRenderThreadQueue(PCIRenderJob job);
+void CInternalRenderThreadShutdown(void); // runs all queued jobs first
+
+#endif
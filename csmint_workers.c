@@ -0,0 +1,119 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_workers.c>
+
+#include "csmint_workers.h"
+
+static void _takeJobs(PCIWorkerPool pool, UINT32 workerIndex) {
+	// jobs that start a run of their own run it inline, see CInternalWorkerRun
+	PCIThreadState state = CInternalGetThreadState();
+	state->inWorkerJob = TRUE;
+	state->workerIndex = workerIndex;
+
+	while (TRUE) {
+		LONG jobIndex = InterlockedIncrement(&pool->nextJob) - 1;
+		if (jobIndex >= (LONG)pool->jobCount) break;
+		pool->jobProc(pool->jobParam, jobIndex, workerIndex);
+	}
+
+	state->inWorkerJob = FALSE;
+}
+
+static DWORD WINAPI _workerProc(LPVOID param) {
+	PCIWorkerPool pool = param;
+
+	while (TRUE) {
+		WaitForSingleObject(pool->startSemaphore, INFINITE);
+		if (pool->shutdown == TRUE) return ZERO;
+
+		// calling thread is always worker 0
+		UINT32 workerIndex = InterlockedIncrement(&pool->nextWorkerIndex);
+		_takeJobs(pool, workerIndex);
+
+		// last thread out signals the caller
+		if (InterlockedDecrement(&pool->threadsRunning) == 0)
+			SetEvent(pool->doneEvent);
+	}
+}
+
+static __forceinline UINT32 _getThreadCount(void) {
+	// leave one processor for the calling thread, which also takes jobs
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	return min(CSMINT_MAX_WORKERS - 1, max(1, sysInfo.dwNumberOfProcessors) - 1);
+}
+
+static PCIWorkerPool _getPool(void) {
+	// lazily make pool on first use
+	if (_csmint.workerPool != NULL) return _csmint.workerPool;
+
+	PCIWorkerPool pool = CInternalAlloc(sizeof(CIWorkerPool));
+
+	pool->threadCount = _getThreadCount();
+
+	pool->startSemaphore = CreateSemaphoreA(NULL, ZERO, CSMINT_MAX_WORKERS, NULL);
+	pool->doneEvent		 = CreateEventA(NULL, FALSE, FALSE, NULL);
+	for (UINT32 threadID = 0; threadID < pool->threadCount; threadID++) {
+		pool->threads[threadID] = CreateThread(NULL, ZERO, _workerProc, pool, ZERO, NULL);
+	}
+
+	_csmint.workerPool = pool;
+	return pool;
+}
+
+UINT32 CInternalWorkerCount(void) {
+	// note: does not take workerLock, callers may be holding the global lock
+	return _getThreadCount() + 1;
+}
+
+void CInternalWorkerRun(PCIWorkerJobProc jobProc, PVOID param, UINT32 jobCount) {
+	// runs started from inside a job (shaders calling back into the api) can't wait on
+	// the pool they are part of, so their jobs run on this thread under its worker index
+	PCIThreadState state = CInternalGetThreadState();
+	if (state->inWorkerJob == TRUE) {
+		for (UINT32 jobIndex = 0; jobIndex < jobCount; jobIndex++)
+			jobProc(param, jobIndex, state->workerIndex);
+		return;
+	}
+
+	// only one run may use the pool at a time
+	EnterCriticalSection(&_csmint.workerLock);
+
+	PCIWorkerPool pool = _getPool();
+	pool->jobProc	= jobProc;
+	pool->jobParam	= param;
+	pool->jobCount	= jobCount;
+	pool->nextJob	= 0;
+	pool->nextWorkerIndex = 0;
+	pool->threadsRunning  = pool->threadCount;
+
+	// wake workers and help out from the calling thread
+	if (pool->threadCount > 0)
+		ReleaseSemaphore(pool->startSemaphore, pool->threadCount, NULL);
+	_takeJobs(pool, 0);
+
+	if (pool->threadCount > 0)
+		WaitForSingleObject(pool->doneEvent, INFINITE);
+
+	LeaveCriticalSection(&_csmint.workerLock);
+}
+
+void CInternalWorkerShutdown(void) {
+	EnterCriticalSection(&_csmint.workerLock);
+
+	PCIWorkerPool pool = _csmint.workerPool;
+	if (pool != NULL) {
+		pool->shutdown = TRUE;
+		ReleaseSemaphore(pool->startSemaphore, pool->threadCount, NULL);
+		for (UINT32 threadID = 0; threadID < pool->threadCount; threadID++) {
+			WaitForSingleObject(pool->threads[threadID], INFINITE);
+			CloseHandle(pool->threads[threadID]);
+		}
+		CloseHandle(pool->startSemaphore);
+		CloseHandle(pool->doneEvent);
+		CInternalFree(pool);
+		_csmint.workerPool = NULL;
+	}
+
+	LeaveCriticalSection(&_csmint.workerLock);
+}
@@ -0,0 +1,36 @@
+// Bailey Jia-Tao Brown
+// 2023
+// <csmint_workers.h>
+
+#ifndef _CSMINT_WORKERS_INCLUDE_
+#define _CSMINT_WORKERS_INCLUDE_
+
+#include "csmint.h"
+
+#define CSMINT_MAX_WORKERS		0x40
+
+// job callback, called once per job index
+// workerIndex is stable for the duration of a run and is < CInternalWorkerCount()
+typedef void (*PCIWorkerJobProc)(PVOID param, UINT32 jobIndex, UINT32 workerIndex);
+
+typedef struct CIWorkerPool {
+	UINT32	threadCount; // does not include the calling thread
+	HANDLE	threads[CSMINT_MAX_WORKERS];
+	HANDLE	startSemaphore;
+	HANDLE	doneEvent;
+	BOOL	shutdown;
+
+	PCIWorkerJobProc jobProc;
+	PVOID			 jobParam;
+	UINT32			 jobCount;
+	volatile LONG	 nextJob;
+	volatile LONG	 threadsRunning;
+	volatile LONG	 nextWorkerIndex;
+} CIWorkerPool, *PCIWorkerPool;
+
+UINT32 CInternalWorkerCount(void);
+// note: a run started from inside a job runs all of its jobs on the calling thread
+void   CInternalWorkerRun(PCIWorkerJobProc jobProc, PVOID param, UINT32 jobCount);
+void   CInternalWorkerShutdown(void);
+
+#endif